@@ -1,73 +1,205 @@
-#include <iostream>
-#include <string>
-#include <variant>
-#include <stdexcept>
-// Include PY.cpp functionality
-#include "PY2.cpp"
+// Build with PY2.cpp or link libpy2.a, using the same -DPY_OJ_* flags
+#include "PY2.h"
 
+static const PY_OJ PY_INT_0(0);
+static const PY_OJ PY_INT_1(1);
+static const PY_OJ PY_INT_2(2);
+static const PY_OJ PY_FLOAT_0(0.0f);
+static const PY_OJ PY_FLOAT_1(3.14159f);
+static const PY_OJ PY_INT_3(3);
+static const PY_OJ PY_STR_0("hello");
+static const PY_OJ PY_INT_4(4);
+static const PY_OJ PY_STR_1("hi");
+static const PY_OJ PY_INT_5(5);
+static const PY_OJ PY_INT_10(10);
+static const PY_OJ PY_INT_20(20);
+static const PY_OJ PY_INT_100000(100000);
+static const PY_OJ PY_FLOAT_2(2.5f);
+
+int64_t native_rec_add(int64_t a, int64_t b);
+int64_t native_add(int64_t a, int64_t b, int64_t v);
+int64_t native_fibonacci(int64_t n);
+int64_t native_min(int64_t a, int64_t b);
+int64_t native_power(int64_t a, int64_t b);
+float native_calculate_circle_area(float radius);
+int64_t native_nested(int64_t a, int64_t b);
+
+int64_t native_rec_add(int64_t a, int64_t b) {
+  int64_t py_acc = 0;
+  py_tail_call:
+  if (a == 0) {
+    return PY_CHECKED_ADD(py_acc, 0);
+  }
+  else {
+    py_acc = PY_CHECKED_ADD(py_acc, b);
+    a = PY_CHECKED_SUB(a, 1);
+    goto py_tail_call;
+  }
+}
 PY_OJ rec_add(PY_OJ a, PY_OJ b) {
-  if (PY_COMPARE(a, std::equal_to<>(), PY_OJ(0))) {
-    return PY_OJ(0);
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && a.is_int() && b.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_rec_add(a.int_value(), b.int_value()))
+  }
+  PY_OJ py_acc = PY_OJ(0);
+  py_tail_call:
+  if (PY_COMPARE(a, std::equal_to<>(), PY_INT_0)) {
+    return PY_ADD(py_acc, PY_INT_0);
   }
   else {
-    return PY_ADD(rec_add(PY_SUB(a, PY_OJ(1)), b), b);
+    py_acc = PY_ADD(py_acc, b);
+    a = PY_SUB(a, PY_INT_1);
+    goto py_tail_call;
   }
 }
+int64_t native_add(int64_t a, int64_t b, int64_t v) {
+  return PY_CHECKED_ADD(PY_CHECKED_ADD(a, b), v);
+}
 PY_OJ add(PY_OJ a, PY_OJ b, PY_OJ v) {
-  return PY_ADD(PY_ADD(a, b), v);
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && a.is_int() && b.is_int() && v.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_add(a.int_value(), b.int_value(), v.int_value()))
+  }
+  return PY_ADD(PY_ADD(std::move(a), b), v);
+}
+int64_t native_fibonacci(int64_t n) {
+  if (n <= 1) {
+    return n;
+  }
+  else {
+    return PY_CHECKED_ADD(native_fibonacci(PY_CHECKED_SUB(n, 1)), native_fibonacci(PY_CHECKED_SUB(n, 2)));
+  }
 }
 PY_OJ fibonacci(PY_OJ n) {
-  if (PY_COMPARE(n, std::less_equal<>(), PY_OJ(1))) {
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && n.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_fibonacci(n.int_value()))
+  }
+  if (PY_COMPARE(n, std::less_equal<>(), PY_INT_1)) {
     return n;
   }
   else {
-    return PY_ADD(fibonacci(PY_SUB(n, PY_OJ(1))), fibonacci(PY_SUB(n, PY_OJ(2))));
+    return PY_ADD(fibonacci(PY_SUB(n, PY_INT_1)), fibonacci(PY_SUB(n, PY_INT_2)));
   }
 }
+int64_t native_min(int64_t a, int64_t b) {
+  if (a < b) {
+    return a;
+  }
+  return b;
+}
 PY_OJ min(PY_OJ a, PY_OJ b) {
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && a.is_int() && b.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_min(a.int_value(), b.int_value()))
+  }
   if (PY_COMPARE(a, std::less<>(), b)) {
     return a;
   }
   return b;
 }
+int64_t native_power(int64_t a, int64_t b) {
+  int64_t py_acc = 1;
+  py_tail_call:
+  if (b == 0) {
+    return PY_CHECKED_MULT(py_acc, 1);
+  }
+  else {
+    py_acc = PY_CHECKED_MULT(py_acc, a);
+    b = PY_CHECKED_SUB(b, 1);
+    goto py_tail_call;
+  }
+}
 PY_OJ power(PY_OJ a, PY_OJ b) {
-  if (PY_COMPARE(b, std::equal_to<>(), PY_OJ(0))) {
-    return PY_OJ(1);
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && a.is_int() && b.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_power(a.int_value(), b.int_value()))
+  }
+  PY_OJ py_acc = PY_OJ(1);
+  py_tail_call:
+  if (PY_COMPARE(b, std::equal_to<>(), PY_INT_0)) {
+    return PY_MULT(py_acc, PY_INT_1);
   }
   else {
-    return PY_MULT(a, power(a, PY_SUB(b, PY_OJ(1))));
+    py_acc = PY_MULT(py_acc, a);
+    b = PY_SUB(b, PY_INT_1);
+    goto py_tail_call;
+  }
+}
+float native_calculate_circle_area(float radius) {
+  float area = 0;
+  if (radius <= 0) {
+    return 0.0f;
+  }
+  else {
+    area = ((3.14159f * radius) * radius);
+    return area;
   }
 }
 PY_OJ calculate_circle_area(PY_OJ radius) {
-  auto pi = PY_OJ(3.14159f);
-  if (PY_COMPARE(radius, std::less_equal<>(), PY_OJ(0))) {
-    return PY_OJ(0.0f);
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && radius.type() == PY_OJ_Type::FLOAT) {
+    PY_GUARDED_NATIVE(py_fallback, native_calculate_circle_area(radius.float_value()))
+  }
+  PY_OJ area;
+  if (PY_COMPARE(radius, std::less_equal<>(), PY_INT_0)) {
+    return PY_FLOAT_0;
   }
   else {
-    auto area = PY_MULT(PY_MULT(pi, radius), radius);
+    area = PY_MULT(PY_MULT(PY_FLOAT_1, radius), radius);
     return area;
   }
 }
 PY_OJ divide(PY_OJ a, PY_OJ b) {
-  if (PY_COMPARE(b, std::equal_to<>(), PY_OJ(0))) {
-    return PY_OJ(0);
+  PY_CALL_FRAME();
+  if (PY_COMPARE(b, std::equal_to<>(), PY_INT_0)) {
+    return PY_INT_0;
   }
   else {
     return PY_DIV(a, b);
   }
 }
+int64_t native_nested(int64_t a, int64_t b) {
+  if (a < b) {
+    if (a == 0) {
+      return 0;
+    }
+    else {
+      return native_min(a, 3);
+    }
+  }
+  else {
+    if (b == 0) {
+      return 0;
+    }
+    else {
+      return b;
+    }
+  }
+}
 PY_OJ nested(PY_OJ a, PY_OJ b) {
+  PY_CALL_FRAME();
+  PY_NATIVE_FALLBACK py_fallback;
+  if (!PY_NATIVE_FALLBACK::active && a.is_int() && b.is_int()) {
+    PY_GUARDED_NATIVE(py_fallback, native_nested(a.int_value(), b.int_value()))
+  }
   if (PY_COMPARE(a, std::less<>(), b)) {
-    if (PY_COMPARE(a, std::equal_to<>(), PY_OJ(0))) {
-      return PY_OJ(0);
+    if (PY_COMPARE(a, std::equal_to<>(), PY_INT_0)) {
+      return PY_INT_0;
     }
     else {
-      return min(a, PY_OJ(3));
+      return min(std::move(a), PY_INT_3);
     }
   }
   else {
-    if (PY_COMPARE(b, std::equal_to<>(), PY_OJ(0))) {
-      return PY_OJ(0);
+    if (PY_COMPARE(b, std::equal_to<>(), PY_INT_0)) {
+      return PY_INT_0;
     }
     else {
       return b;
@@ -75,49 +207,54 @@ PY_OJ nested(PY_OJ a, PY_OJ b) {
   }
 }
 PY_OJ abs(PY_OJ n) {
-  if (PY_COMPARE(n, std::less<>(), PY_OJ(0))) {
-    return PY_MULT(n, PY_OJ(1));
+  PY_CALL_FRAME();
+  if (PY_COMPARE(n, std::less<>(), PY_INT_0)) {
+    return PY_MULT(n, PY_INT_1);
   }
   else {
     return n;
   }
 }
 PY_OJ fib_next(PY_OJ n) {
-  if (PY_COMPARE(n, std::less<>(), PY_OJ(0))) {
-    return PY_OJ(0);
+  PY_CALL_FRAME();
+  if (PY_COMPARE(n, std::less<>(), PY_INT_0)) {
+    return PY_INT_0;
   }
   else {
-    return PY_OJ("hello");
+    return PY_STR_0;
   }
 }
 PY_OJ mult(PY_OJ a, PY_OJ b) {
+  PY_CALL_FRAME();
   return PY_MULT(a, b);
 }
 void test_lists() {
-  auto my_list = PY_OJ({std::vector<PY_OJ>{PY_OJ(1), PY_OJ(2), PY_OJ(3)}});
-  PY_LIST_APPEND(my_list, PY_OJ(4));
-  PY_LIST_APPEND(my_list, PY_OJ("hi"));
+  PY_CALL_FRAME();
+  auto my_list = PY_OJ(std::vector<int64_t>{1, 2, 3});
+  PY_LIST_APPEND(my_list, PY_INT_4);
+  PY_LIST_APPEND(my_list, PY_STR_1);
   PY_PRINT(my_list);
-  PY_PRINT(PY_LIST_GET(my_list, PY_OJ(2)));
-  PY_LIST_APPEND(my_list, PY_OJ({std::vector<PY_OJ>{PY_OJ(1), PY_OJ(2), PY_OJ(3)}}));
+  PY_PRINT(PY_GETITEM(my_list, PY_INT_2));
+  PY_LIST_APPEND(my_list, PY_OJ(std::vector<int64_t>{1, 2, 3}));
   PY_PRINT(my_list);
   PY_LIST_APPEND(my_list, my_list);
   PY_PRINT(my_list);
 }
 void py_main() {
-  PY_PRINT(rec_add(PY_OJ(5), PY_OJ(5)));
-  PY_PRINT(add(PY_OJ(5), PY_OJ(5), PY_OJ(5)));
-  PY_PRINT(fibonacci(PY_OJ(10)));
-  PY_PRINT(fibonacci(PY_OJ(20)));
-  PY_PRINT(min(PY_OJ(2), PY_OJ(100000)));
-  PY_PRINT(power(PY_OJ(2), PY_OJ(5)));
-  PY_PRINT(calculate_circle_area(PY_OJ(2.5f)));
-  PY_PRINT(divide(PY_OJ(10), PY_OJ(2)));
-  PY_PRINT(divide(PY_OJ(10), PY_OJ(0)));
-  PY_PRINT(divide(PY_OJ(10), PY_OJ(3)));
-  PY_PRINT(nested(PY_OJ(5), PY_OJ(10)));
-  PY_PRINT(fib_next(PY_OJ(10)));
-  PY_PRINT(mult(PY_OJ("hi"), PY_OJ(3)));
+  PY_CALL_FRAME();
+  PY_PRINT(PY_NATIVE_CALL(native_rec_add(5, 5), rec_add(PY_INT_5, PY_INT_5)));
+  PY_PRINT(PY_NATIVE_CALL(native_add(5, 5, 5), add(PY_INT_5, PY_INT_5, PY_INT_5)));
+  PY_PRINT(PY_NATIVE_CALL(native_fibonacci(10), fibonacci(PY_INT_10)));
+  PY_PRINT(PY_NATIVE_CALL(native_fibonacci(20), fibonacci(PY_INT_20)));
+  PY_PRINT(PY_NATIVE_CALL(native_min(2, 100000), min(PY_INT_2, PY_INT_100000)));
+  PY_PRINT(PY_NATIVE_CALL(native_power(2, 5), power(PY_INT_2, PY_INT_5)));
+  PY_PRINT(PY_NATIVE_CALL(native_calculate_circle_area(2.5f), calculate_circle_area(PY_FLOAT_2)));
+  PY_PRINT(divide(PY_INT_10, PY_INT_2));
+  PY_PRINT(divide(PY_INT_10, PY_INT_0));
+  PY_PRINT(divide(PY_INT_10, PY_INT_3));
+  PY_PRINT(PY_NATIVE_CALL(native_nested(5, 10), nested(PY_INT_5, PY_INT_10)));
+  PY_PRINT(fib_next(PY_INT_10));
+  PY_PRINT(mult(PY_STR_1, PY_INT_3));
   test_lists();
 }
 int main() {
@@ -0,0 +1,198 @@
+"""Transpiles many Python modules at once, one C++ translation unit each.
+
+Every module becomes <out>/<path>.cpp plus a <out>/<path>.h declaring its
+functions, in a namespace of its own (pkg/util.py -> py_module_pkg::
+py_module_util), so modules can define functions with the same name.
+`import pkg.util`, `from pkg.util import f` and relative imports of other
+modules of the batch include their header and call them by qualified name.
+The module given with --main also gets the program's int main().
+
+Modules are transpiled in parallel. Each output starts with a cache key
+hashed from the module's source, the declarations of the modules it
+imports, the options and the transpiler itself; a module whose outputs
+already carry its key is skipped, and its files are left untouched.
+
+  python3 PY2-BATCH.py -o build pkg/ [more.py ...] [--main pkg.app] [-j N] [--memo] [--profile] [--parallel] [--force]
+  c++ -std=c++17 -O2 -I build -I . $(find build -name '*.cpp') PY2.cpp
+"""
+import argparse
+import ast
+import hashlib
+import importlib.util
+import os
+import sys
+from concurrent.futures import ProcessPoolExecutor
+
+REPO_DIR = os.path.dirname(os.path.abspath(__file__))
+CACHE_STAMP = "// PY2-BATCH cache key: "
+
+def load_transpiler():
+    spec = importlib.util.spec_from_file_location('py2cpp', os.path.join(REPO_DIR, 'PY2-CPP.py'))
+    module = importlib.util.module_from_spec(spec)
+    # Registered so the workers can unpickle its classes (BatchModule)
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+py2cpp = load_transpiler()
+
+def transpiler_version():
+    # Any edit to the transpiler invalidates every cached module
+    digest = hashlib.sha256()
+    for name in ('PY2-CPP.py', 'PY2-BATCH.py'):
+        with open(os.path.join(REPO_DIR, name), 'rb') as file:
+            digest.update(file.read())
+    return digest.hexdigest()
+
+def find_sources(paths):
+    sources = set()
+    for path in paths:
+        if os.path.isdir(path):
+            for directory, _, files in os.walk(path):
+                sources.update(os.path.join(directory, f) for f in files if f.endswith('.py'))
+        else:
+            sources.add(path)
+    return sorted(os.path.normpath(path) for path in sources)
+
+def default_root(paths):
+    # Modules are named relative to the directory holding the inputs; a
+    # directory argument is a package, named after itself
+    dirs = [os.path.dirname(os.path.abspath(p.rstrip('/'))) if os.path.isdir(p)
+            else os.path.dirname(os.path.abspath(p)) for p in paths]
+    return os.path.commonpath(dirs)
+
+def module_path(source, root):
+    """(dotted module name, path without .py relative to root, is package)."""
+    rel = os.path.relpath(os.path.abspath(source), root)[:-3].replace(os.sep, '/')
+    parts = rel.split('/')
+    is_package = parts[-1] == '__init__'
+    if is_package:
+        parts.pop()
+    return '.'.join(parts), rel, is_package
+
+def scan(source):
+    """Source text, function names and declarations of one module."""
+    with open(source) as file:
+        code = file.read()
+    tree = ast.parse(code, source)
+    functions = [node.name for node in tree.body if isinstance(node, ast.FunctionDef)]
+    return code, functions, py2cpp.module_interface(tree)
+
+def scan_or_error(source):
+    try:
+        return scan(source)
+    except (OSError, SyntaxError) as error:
+        return f"{source}: {error}"
+
+def stamped(path, key):
+    try:
+        with open(path) as file:
+            return file.readline().rstrip('\n') == CACHE_STAMP + key
+    except OSError:
+        return False
+
+def write_atomic(path, content):
+    os.makedirs(os.path.dirname(path) or '.', exist_ok=True)
+    temp = f"{path}.tmp{os.getpid()}"
+    with open(temp, 'w') as file:
+        file.write(content)
+    os.replace(temp, path)
+
+def include_guard(module):
+    return module.namespace.replace('::', '_').upper() + '_H'
+
+def transpile(job):
+    """Worker: converts one module and writes its header and translation
+    unit. Returns an error message, or None."""
+    code, module, interface, includes, rel, out_dir, key, options = job
+    try:
+        converter = py2cpp.convert_module(code, module=module, **options)
+    except Exception as error:
+        return f"{module.name}: {type(error).__name__}: {error}"
+    stamp = CACHE_STAMP + key
+    header = [stamp,
+              f"// Functions of module {module.name}, for the modules that import it",
+              f"#ifndef {include_guard(module)}",
+              f"#define {include_guard(module)}",
+              "",
+              '#include "PY2.h"',
+              "",
+              f"namespace {module.namespace} {{",
+              *interface,
+              "}",
+              "",
+              "#endif",
+              ""]
+    cpp = [stamp,
+           "// Build with PY2.cpp or link libpy2.a, using the same -DPY_OJ_* flags",
+           *(f'#include "{path}.h"' for path in [rel] + includes),
+           "",
+           py2cpp.generate_cpp(converter),
+           ""]
+    write_atomic(os.path.join(out_dir, rel + '.h'), '\n'.join(header))
+    write_atomic(os.path.join(out_dir, rel + '.cpp'), '\n'.join(cpp))
+    return None
+
+def main():
+    parser = argparse.ArgumentParser(description="Transpile Python modules to C++ translation units in parallel")
+    parser.add_argument('sources', nargs='+', help="Python files, or directories searched for *.py")
+    parser.add_argument('-o', '--output', required=True, help="directory for the generated .cpp/.h files")
+    parser.add_argument('--root', help="directory module names are relative to (default: the inputs' parent)")
+    parser.add_argument('--main', metavar='MODULE', help="module whose main() becomes the program's entry point")
+    parser.add_argument('-j', '--jobs', type=int, default=os.cpu_count(), help="parallel workers (default: all cores)")
+    parser.add_argument('--memo', action='store_true', help="as PY2-CPP.py --memo")
+    parser.add_argument('--profile', action='store_true', help="as PY2-CPP.py --profile")
+    parser.add_argument('--parallel', action='store_true', help="as PY2-CPP.py --parallel")
+    parser.add_argument('--force', action='store_true', help="retranspile modules whose outputs are up to date")
+    args = parser.parse_args()
+
+    sources = find_sources(args.sources)
+    root = os.path.abspath(args.root) if args.root else default_root(args.sources)
+    options = {'memo': args.memo, 'profile': args.profile, 'parallel': args.parallel}
+    version = transpiler_version()
+    errors = []
+
+    with ProcessPoolExecutor(max_workers=args.jobs) as pool:
+        modules, scanned = {}, {}
+        for source, result in zip(sources, pool.map(scan_or_error, sources)):
+            if isinstance(result, str):
+                errors.append(result)
+                continue
+            name, rel, is_package = module_path(source, root)
+            if name in modules:
+                errors.append(f"{source}: module {name} is also defined by {modules[name][1]}")
+                continue
+            modules[name] = (py2cpp.BatchModule(name, is_package, entry=name == args.main), source, rel)
+            scanned[name] = result
+        if args.main and args.main not in modules:
+            errors.append(f"--main: {args.main} is not part of the batch")
+        elif args.main and 'main' not in scanned[args.main][1]:
+            errors.append(f"--main: {args.main} does not define main()")
+
+        functions = {name: set(result[1]) for name, result in scanned.items()}
+        jobs, skipped = [], 0
+        for name, (module, source, rel) in modules.items():
+            code, _, interface = scanned[name]
+            try:
+                module.link(ast.parse(code, source), functions)
+            except ValueError as error:
+                errors.append(str(error))
+                continue
+            key = hashlib.sha256(repr((version, sorted(options.items()), name, module.entry, code,
+                                       [(dep, scanned[dep][2]) for dep in module.deps])).encode()).hexdigest()
+            out_base = os.path.join(args.output, rel)
+            if not args.force and stamped(out_base + '.cpp', key) and stamped(out_base + '.h', key):
+                skipped += 1
+                continue
+            includes = [modules[dep][2] for dep in module.deps]
+            jobs.append((code, module, interface, includes, rel, args.output, key, options))
+        errors += [error for error in pool.map(transpile, jobs) if error]
+
+    print(f"{len(modules)} modules: {len(jobs)} transpiled, {skipped} up to date, {len(errors)} errors")
+    for error in errors:
+        print(error, file=sys.stderr)
+    if errors:
+        sys.exit(1)
+
+if __name__ == '__main__':
+    main()
@@ -1,40 +1,923 @@
+import argparse
 import ast
+import math
+import struct
+
+# Python types that have a native C++ counterpart in specialized code
+NATIVE_TYPES = {'int': 'int64_t', 'float': 'float'}
+
+# Ints outside this range do not fit int64_t and are emitted as PY_BIGINT
+INT64_MIN = -2**63
+INT64_MAX = 2**63 - 1
+
+def to_float32(value):
+    # The runtime's floats are 32-bit; values beyond their range become
+    # +-inf (older Pythons raise OverflowError from pack instead)
+    try:
+        return struct.unpack('f', struct.pack('f', value))[0]
+    except OverflowError:
+        return math.copysign(math.inf, value)
+
+def finite(value):
+    # A folded float, or None for inf and nan, which are left to the runtime
+    return value if math.isfinite(value) else None
+
+def float_literal(value):
+    # Shortest C++ float literal that reads back as the same float32
+    value = to_float32(value)
+    if math.isnan(value):
+        return "std::numeric_limits<float>::quiet_NaN()"
+    if math.isinf(value):
+        return f"{'-' if value < 0 else ''}std::numeric_limits<float>::infinity()"
+    for digits in range(1, 10):
+        text = f"{value:.{digits}g}"
+        if to_float32(float(text)) == to_float32(value):
+            break
+    if '.' not in text and 'e' not in text:
+        text += '.0'
+    return text + 'f'
+
+class ConstantFolder(ast.NodeTransformer):
+    """Compile-time evaluation over the Python AST, run before type
+    inference and codegen.
+
+    Folds arithmetic on literals with the runtime's semantics (32-bit floats,
+    exact ints), folds comparisons of literals in if/while tests and drops
+    the dead branch, and propagates locals that are assigned a literal
+    exactly once at the top level of a function, so `pi * r * r` with
+    `pi = 3.14159` compiles as `3.14159 * r * r`.
+    """
+
+    # Longest string or widest int a fold may produce
+    MAX_FOLDED_SIZE = 4096
+
+    def __init__(self):
+        self.changed = False
+
+    def fold(self, tree):
+        # Propagation exposes new folds and vice versa, so run to a fixed point
+        while True:
+            self.changed = False
+            self.visit(tree)
+            for func in tree.body:
+                if isinstance(func, ast.FunctionDef):
+                    self.propagate(func)
+            if not self.changed:
+                return tree
+
+    def constant(self, value, like):
+        self.changed = True
+        return ast.copy_location(ast.Constant(value=value), like)
+
+    def visit_UnaryOp(self, node):
+        self.generic_visit(node)
+        if isinstance(node.op, (ast.USub, ast.UAdd)) and is_number(node.operand):
+            value = node.operand.value
+            return self.constant(-value if isinstance(node.op, ast.USub) else value, node)
+        return node
+
+    def visit_BinOp(self, node):
+        self.generic_visit(node)
+        if isinstance(node.left, ast.Constant) and isinstance(node.right, ast.Constant):
+            value = fold_binop(node.op, node.left.value, node.right.value)
+            if value is not None and self.fits(value):
+                return self.constant(value, node)
+        return node
+
+    def constant_test(self, test):
+        # Value of an if/while test that compares two literals, else None.
+        # Comparisons elsewhere are left alone: they yield a C++ bool.
+        if not (isinstance(test, ast.Compare) and len(test.ops) == 1
+                and isinstance(test.left, ast.Constant) and isinstance(test.comparators[0], ast.Constant)):
+            return None
+        a, b = test.left.value, test.comparators[0].value
+        if not ((is_number_value(a) and is_number_value(b)) or (type(a) is str and type(b) is str)):
+            return None
+        op = {ast.Eq: '__eq__', ast.NotEq: '__ne__', ast.Lt: '__lt__', ast.LtE: '__le__',
+              ast.Gt: '__gt__', ast.GtE: '__ge__'}.get(type(test.ops[0]))
+        return bool(getattr(a, op)(b)) if op else None
+
+    def visit_If(self, node):
+        self.generic_visit(node)
+        value = self.constant_test(node.test)
+        if value is not None:
+            self.changed = True
+            return node.body if value else node.orelse
+        return node
+
+    def visit_While(self, node):
+        self.generic_visit(node)
+        if self.constant_test(node.test) is False:
+            self.changed = True
+            return node.orelse
+        return node
+
+    def fits(self, value):
+        if isinstance(value, int):
+            return value.bit_length() <= self.MAX_FOLDED_SIZE
+        if isinstance(value, str):
+            return len(value) <= self.MAX_FOLDED_SIZE
+        return True
+
+    def propagate(self, func):
+        stores = {}
+        for node in ast.walk(func):
+            if isinstance(node, ast.Name) and isinstance(node.ctx, (ast.Store, ast.Del)):
+                stores[node.id] = stores.get(node.id, 0) + 1
+            elif isinstance(node, (ast.Global, ast.Nonlocal)):
+                return
+        params = {arg.arg for arg in func.args.args}
+        for index, stmt in enumerate(func.body):
+            if not (isinstance(stmt, ast.Assign) and len(stmt.targets) == 1
+                    and isinstance(stmt.targets[0], ast.Name) and isinstance(stmt.value, ast.Constant)):
+                continue
+            name = stmt.targets[0].id
+            if name in params or stores.get(name) != 1:
+                continue
+            # Every read must come after the assignment
+            earlier = [n for s in func.body[:index + 1] for n in ast.walk(s)]
+            if any(isinstance(n, ast.Name) and n.id == name and isinstance(n.ctx, ast.Load) for n in earlier):
+                continue
+            value = stmt.value.value
+            for later in func.body[index + 1:]:
+                for n in ast.walk(later):
+                    for field, child in ast.iter_fields(n):
+                        if isinstance(child, ast.Name) and child.id == name:
+                            setattr(n, field, ast.copy_location(ast.Constant(value=value), child))
+                        elif isinstance(child, list):
+                            child[:] = [ast.copy_location(ast.Constant(value=value), c)
+                                        if isinstance(c, ast.Name) and c.id == name else c for c in child]
+            del func.body[index]
+            if not func.body:
+                func.body.append(ast.Pass())
+            self.changed = True
+            return
+
+def is_number_value(value):
+    return type(value) in (int, float)
+
+def is_number(node):
+    return isinstance(node, ast.Constant) and is_number_value(node.value)
+
+def fold_binop(op, a, b):
+    """a op b as the runtime computes it, or None if it cannot be folded."""
+    try:
+        if type(a) is int and type(b) is int:
+            if isinstance(op, ast.Add):
+                return a + b
+            if isinstance(op, ast.Sub):
+                return a - b
+            if isinstance(op, ast.Mult):
+                return a * b
+            if isinstance(op, ast.Div) and b != 0:
+                return finite(to_float32(a / b))
+        elif is_number_value(a) and is_number_value(b):
+            # Mixed or float operands: both are converted to float first
+            a, b = to_float32(a), to_float32(b)
+            if isinstance(op, ast.Add):
+                return finite(to_float32(a + b))
+            if isinstance(op, ast.Sub):
+                return finite(to_float32(a - b))
+            if isinstance(op, ast.Mult):
+                return finite(to_float32(a * b))
+            if isinstance(op, ast.Div) and b != 0:
+                return finite(to_float32(a / b))
+        elif isinstance(op, ast.Add) and type(a) is str and type(b) is str:
+            return a + b
+        elif isinstance(op, ast.Mult) and {type(a), type(b)} == {str, int}:
+            text, count = (a, b) if type(a) is str else (b, a)
+            if len(text) * max(count, 0) <= ConstantFolder.MAX_FOLDED_SIZE:
+                return text * count
+    except OverflowError:
+        pass
+    return None
+
+def join_types(a, b):
+    # None means "no information yet"; any disagreement makes the slot dynamic
+    if a is None:
+        return b
+    if b is None or a == b:
+        return a
+    return 'dyn'
+
+class TypeInference:
+    """Whole-module local type inference.
+
+    Parameter types come from every call site in the module, local types from
+    every assignment and return types from every return statement, iterated to
+    a fixed point. Types are 'int', 'float', 'str', 'list', 'dict', 'bool',
+    'none' and 'dyn' (mixed or unknown).
+
+    assumed maps function names to parameter types taken as given instead of
+    being joined from the call sites (from a type profile, see
+    read_type_profile); code typed that way is only correct behind a guard.
+    """
+
+    def __init__(self, tree, assumed=None):
+        self.functions = {node.name: node for node in tree.body if isinstance(node, ast.FunctionDef)}
+        self.params = {name: [None] * len(func.args.args) for name, func in self.functions.items()}
+        self.assumed = assumed or {}
+        for name, types in self.assumed.items():
+            self.params[name] = list(types)
+        self.locals = {name: {} for name in self.functions}
+        self.returns = {name: None for name in self.functions}
+
+    def run(self):
+        changed = True
+        while changed:
+            changed = False
+            for name, func in self.functions.items():
+                changed |= self.infer_function(name, func)
+        return self
+
+    def env(self, name):
+        func = self.functions[name]
+        env = {arg.arg: t for arg, t in zip(func.args.args, self.params[name])}
+        # Locals not typed yet are None rather than unknown globals ('dyn')
+        for node in ast.walk(func):
+            if isinstance(node, ast.Name) and isinstance(node.ctx, ast.Store):
+                env.setdefault(node.id, None)
+        for local, t in self.locals[name].items():
+            env[local] = join_types(env.get(local), t)
+        return env
+
+    def infer_function(self, name, func):
+        env = self.env(name)
+        before = (list(map(list, self.params.values())), dict(self.returns), repr(self.locals))
+        for node in ast.walk(func):
+            if isinstance(node, ast.Assign):
+                for target in node.targets:
+                    if isinstance(target, ast.Name):
+                        t = self.expr_type(node.value, env)
+                        self.locals[name][target.id] = join_types(self.locals[name].get(target.id), t)
+            elif isinstance(node, ast.AugAssign) and isinstance(node.target, ast.Name):
+                t = self.expr_type(ast.BinOp(left=node.target, op=node.op, right=node.value), env)
+                self.locals[name][node.target.id] = join_types(self.locals[name].get(node.target.id), t)
+            elif isinstance(node, (ast.For, ast.comprehension)) and isinstance(node.target, ast.Name):
+                t = 'int' if is_range_loop(node, self.functions) else 'dyn'
+                self.locals[name][node.target.id] = join_types(self.locals[name].get(node.target.id), t)
+            elif isinstance(node, ast.Return):
+                t = 'none' if node.value is None else self.expr_type(node.value, env)
+                self.returns[name] = join_types(self.returns[name], t)
+            elif isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and node.func.id in self.functions:
+                callee = node.func.id
+                if callee in self.assumed:
+                    continue
+                if len(node.args) != len(self.params[callee]) or node.keywords:
+                    self.params[callee] = ['dyn'] * len(self.params[callee])
+                    continue
+                for i, arg in enumerate(node.args):
+                    self.params[callee][i] = join_types(self.params[callee][i], self.expr_type(arg, env))
+        return before != (list(map(list, self.params.values())), dict(self.returns), repr(self.locals))
+
+    def expr_type(self, node, env):
+        if isinstance(node, ast.Constant):
+            if isinstance(node.value, bool):
+                return 'bool'
+            return {int: 'int', float: 'float', str: 'str'}.get(type(node.value), 'dyn')
+        if isinstance(node, ast.Name):
+            return env.get(node.id, 'dyn')
+        if isinstance(node, ast.BinOp):
+            left = self.expr_type(node.left, env)
+            right = self.expr_type(node.right, env)
+            if left is None or right is None:
+                return None
+            if left in NATIVE_TYPES and right in NATIVE_TYPES:
+                if isinstance(node.op, ast.Div):
+                    return 'float'
+                if isinstance(node.op, (ast.Add, ast.Sub, ast.Mult)):
+                    return 'int' if left == right == 'int' else 'float'
+            if isinstance(node.op, ast.Add) and left == right and left in ('str', 'list'):
+                return left
+            if isinstance(node.op, ast.Mult) and {left, right} == {'str', 'int'}:
+                return 'str'
+            return 'dyn'
+        if isinstance(node, ast.UnaryOp):
+            if isinstance(node.op, ast.Not):
+                return 'bool'
+            operand = self.expr_type(node.operand, env)
+            return operand if operand is None or operand in NATIVE_TYPES else 'dyn'
+        if isinstance(node, ast.Compare):
+            return 'bool'
+        if isinstance(node, (ast.List, ast.ListComp, ast.GeneratorExp)):
+            return 'list'
+        if isinstance(node, (ast.Dict, ast.DictComp)):
+            return 'dict'
+        if isinstance(node, ast.Call) and isinstance(node.func, ast.Name):
+            if node.func.id in self.functions:
+                return self.returns[node.func.id]
+            if node.func.id == 'print':
+                return 'none'
+        return 'dyn'
+
+    def specialize(self, exclude=()):
+        """Returns {name: (param types, return type)} for the functions whose
+        whole body can be emitted as native int/float code."""
+        candidates = {}
+        for name, func in self.functions.items():
+            env = self.env(name)
+            slots = list(self.params[name]) + list(env.values()) + [self.returns[name]]
+            if name != 'main' and name not in exclude and all(t in NATIVE_TYPES for t in slots):
+                candidates[name] = (list(self.params[name]), self.returns[name])
+        # Drop candidates that call something that is not itself native, until stable
+        changed = True
+        while changed:
+            changed = False
+            for name in list(candidates):
+                env = self.env(name)
+                if not all(self.native_stmt_ok(stmt, env, candidates) for stmt in self.functions[name].body):
+                    del candidates[name]
+                    changed = True
+        return candidates
+
+    def native_stmt_ok(self, node, env, native):
+        if isinstance(node, ast.Assign):
+            return (len(node.targets) == 1 and isinstance(node.targets[0], ast.Name)
+                    and self.native_expr_ok(node.value, env, native))
+        if isinstance(node, ast.Return):
+            return node.value is not None and self.native_expr_ok(node.value, env, native)
+        if isinstance(node, ast.If):
+            return (self.native_expr_ok(node.test, env, native, allow_compare=True)
+                    and all(self.native_stmt_ok(stmt, env, native) for stmt in node.body + node.orelse))
+        if isinstance(node, ast.AugAssign):
+            return (isinstance(node.target, ast.Name)
+                    and self.native_expr_ok(ast.BinOp(left=node.target, op=node.op, right=node.value), env, native))
+        if isinstance(node, ast.For):
+            return (is_range_loop(node, self.functions) and isinstance(node.target, ast.Name) and not node.orelse
+                    and all(self.expr_type(arg, env) == 'int' and self.native_expr_ok(arg, env, native)
+                            for arg in node.iter.args)
+                    and all(self.native_stmt_ok(stmt, env, native) for stmt in node.body))
+        if isinstance(node, ast.While):
+            return (not node.orelse and self.native_expr_ok(node.test, env, native, allow_compare=True)
+                    and all(self.native_stmt_ok(stmt, env, native) for stmt in node.body))
+        return isinstance(node, (ast.Pass, ast.Break, ast.Continue))
+
+    def native_expr_ok(self, node, env, native, allow_compare=False):
+        if isinstance(node, ast.Constant):
+            if isinstance(node.value, bool):
+                return False
+            if isinstance(node.value, int):
+                return INT64_MIN < node.value <= INT64_MAX
+            return isinstance(node.value, float)
+        if isinstance(node, ast.Name):
+            return env.get(node.id) in NATIVE_TYPES
+        if isinstance(node, ast.BinOp):
+            return (isinstance(node.op, (ast.Add, ast.Sub, ast.Mult, ast.Div))
+                    and self.native_expr_ok(node.left, env, native)
+                    and self.native_expr_ok(node.right, env, native))
+        if isinstance(node, ast.UnaryOp):
+            return isinstance(node.op, (ast.USub, ast.UAdd)) and self.native_expr_ok(node.operand, env, native)
+        if isinstance(node, ast.Compare):
+            return (allow_compare and len(node.ops) == 1
+                    and isinstance(node.ops[0], (ast.Eq, ast.NotEq, ast.Lt, ast.LtE, ast.Gt, ast.GtE))
+                    and self.native_expr_ok(node.left, env, native)
+                    and self.native_expr_ok(node.comparators[0], env, native))
+        if isinstance(node, ast.Call):
+            if not isinstance(node.func, ast.Name) or node.func.id not in native or node.keywords:
+                return False
+            params = native[node.func.id][0]
+            return (len(node.args) == len(params)
+                    and all(self.expr_type(arg, env) == t for arg, t in zip(node.args, params))
+                    and all(self.native_expr_ok(arg, env, native) for arg in node.args))
+        return False
+
+# Builtins that neither mutate their arguments nor have other side effects
+PURE_BUILTINS = {'range', 'len', 'sum', 'min', 'max'}
+
+COMPREHENSIONS = (ast.ListComp, ast.SetComp, ast.DictComp, ast.GeneratorExp)
+
+def is_range_loop(node, functions):
+    # for <name> in range(...) (or a comprehension's for clause) with 1-3
+    # positional arguments, range not shadowed
+    call = node.iter
+    return (isinstance(call, ast.Call) and isinstance(call.func, ast.Name) and call.func.id == 'range'
+            and 'range' not in functions and 1 <= len(call.args) <= 3 and not call.keywords)
+
+def is_self_call(node, func):
+    return (isinstance(node, ast.Call) and isinstance(node.func, ast.Name) and node.func.id == func.name
+            and len(node.args) == len(func.args.args) and not node.keywords
+            and not any(isinstance(arg, ast.Starred) for arg in node.args))
+
+def tail_recursion(func):
+    """How func's self-recursion can become a loop. Returns (tail, op):
+    tail is true if some return is a self tail call `return f(...)`, op is
+    ast.Add or ast.Mult if every other recursive return has the accumulator
+    form `return f(...) op e` (or `e op f(...)`) with a call-free e, and
+    None otherwise."""
+    tail = False
+    ops = set()
+    other_recursion = False
+    for node in ast.walk(func):
+        if not isinstance(node, ast.Return) or node.value is None:
+            continue
+        value = node.value
+        if is_self_call(value, func):
+            tail = True
+        elif accumulator_form(value, func):
+            ops.add(type(value.op))
+        elif any(is_self_call(child, func) for child in ast.walk(value)):
+            other_recursion = True
+    return tail, ops.pop() if len(ops) == 1 and not other_recursion else None
+
+def accumulator_form(value, func):
+    # (recursive call, other operand) of `f(...) op e` / `e op f(...)`, else None
+    if not isinstance(value, ast.BinOp) or not isinstance(value.op, (ast.Add, ast.Mult)):
+        return None
+    for call, other in ((value.left, value.right), (value.right, value.left)):
+        if is_self_call(call, func) and not any(isinstance(n, ast.Call) for n in ast.walk(other)):
+            return call, other
+    return None
+
+def pure_functions(tree):
+    """Functions with no observable side effects: no print, no method calls
+    (list.append mutates its receiver), no subscript stores, and only calls
+    to other pure functions of the module."""
+    functions = {node.name: node for node in tree.body if isinstance(node, ast.FunctionDef)}
+    calls = {}
+    impure = set()
+    for name, func in functions.items():
+        calls[name] = set()
+        for node in ast.walk(func):
+            if isinstance(node, ast.Call):
+                if isinstance(node.func, ast.Name) and node.func.id in functions:
+                    calls[name].add(node.func.id)
+                elif not (isinstance(node.func, ast.Name) and node.func.id in PURE_BUILTINS):
+                    impure.add(name)
+            elif isinstance(node, (ast.Global, ast.Nonlocal)):
+                impure.add(name)
+            elif isinstance(node, ast.Subscript) and isinstance(node.ctx, ast.Store):
+                impure.add(name)
+    changed = True
+    while changed:
+        changed = False
+        for name in functions:
+            if name not in impure and calls[name] & impure:
+                impure.add(name)
+                changed = True
+    return {name for name in functions if name not in impure}
 
 class PythonToCConverter(ast.NodeVisitor):
     def __init__(self):
         self.c_code = []
         self.indent_level = 0
+        # Literal -> (name, initializer) of its interned static const PY_OJ,
+        # emitted once at file scope so no literal is boxed at runtime
+        self.constants = {}
+        # Names of the functions defined in the module being converted
+        self.functions = set()
+        # Name nodes that are the last read of a local and can be moved from
+        self.movable = set()
+        # Functions that also get a native int/float version: name -> (param types, return type)
+        self.native = {}
+        self.inference = None
+        # Locals already declared in the function being emitted
+        self.declared = set()
+        # Pure functions wrapped with a PY_MEMO cache (--memo)
+        self.memoized = set()
+        # Numbers the C++ counters of lowered loops
+        self.loop_count = 0
+        # Self tail calls of the function being emitted become jumps back to
+        # its start: None, or {'func', 'op', 'types'} (see tail_loop)
+        self.tail = None
+        # --profile: every emitted function counts and times its calls,
+        # reported per Python function at exit; (entry, label, def line)
+        self.profile = False
+        self.profile_entries = []
+        # --type-profile-gen: boxed functions and binary ops record the types
+        # they see; (site variable, kind, key) of every PY_TYPE_SITE
+        self.type_profile_gen = False
+        self.type_sites = []
+        # --type-profile: functions natively specialized on their profiled
+        # parameter types (name -> types), and the operand types of
+        # monomorphic binary-op sites (key -> types)
+        self.guarded = {}
+        self.binop_types = {}
+        # Inference the native versions were specialized with; assumes the
+        # profiled parameter types of the guarded functions
+        self.native_inference = None
+        # Python function being emitted
+        self.function_name = None
+        # Batch mode (PY2-BATCH.py): the module's place in the batch, see
+        # BatchModule. None for a standalone program.
+        self.module = None
+        # Functions callable from other modules, whose boxed versions may
+        # be passed and return anything (see tail_loop)
+        self.exported = set()
+        # --parallel: pure list comprehensions map on the thread pool, see
+        # parallel_map; pure holds the module's pure functions
+        self.parallel = False
+        self.pure = set()
 
     def indent(self):
         return "  " * self.indent_level
 
     def has_return(self, node):
-        for stmt in ast.walk(node):
-            if isinstance(stmt, ast.Return):
-                return True
-        return False
+        return has_return(node)
+
+    def find_last_uses(self, node):
+        # A local can be moved from at its last read, as long as it is not
+        # mentioned twice in that statement (argument evaluation order is
+        # unspecified in C++, so a second mention could see the moved-from value).
+        local_names = {arg.arg for arg in node.args.args}
+        local_names |= {n.id for n in ast.walk(node) if isinstance(n, ast.Name) and isinstance(n.ctx, ast.Store)}
+        uses = []
+        # Uses inside a loop run again on the next iteration, so none of
+        # them is a last use
+        in_loop = set()
+
+        def names_in(tree):
+            if isinstance(tree, ast.Name):
+                yield tree
+            for child in ast.iter_child_nodes(tree):
+                yield from names_in(child)
+
+        def collect(stmt):
+            # A comprehension is a loop too
+            for child in ast.walk(stmt):
+                if isinstance(child, COMPREHENSIONS):
+                    in_loop.update(names_in(child))
+            if isinstance(stmt, (ast.For, ast.While)):
+                in_loop.update(names_in(stmt))
+                uses.extend((name, stmt) for name in names_in(stmt))
+            elif isinstance(stmt, ast.If):
+                uses.extend((name, stmt) for name in names_in(stmt.test))
+                for child in stmt.body + stmt.orelse:
+                    collect(child)
+            else:
+                uses.extend((name, stmt) for name in names_in(stmt))
+
+        for stmt in node.body:
+            collect(stmt)
+        last_use = {}
+        for name, stmt in uses:
+            last_use[name.id] = (name, stmt)
+        movable = set()
+        for ident, (name, stmt) in last_use.items():
+            mentions = sum(1 for other, other_stmt in uses if other_stmt is stmt and other.id == ident)
+            if ident in local_names and isinstance(name.ctx, ast.Load) and mentions == 1 and name not in in_loop:
+                movable.add(name)
+        return movable
+
+    def hoisted_locals(self, node):
+        # Locals whose first assignment is inside a nested block must be
+        # declared at function scope so later statements can still see them.
+        seen = {arg.arg for arg in node.args.args}
+        # Comprehension variables are declared inside the comprehension
+        scoped = {target for comp in ast.walk(node) if isinstance(comp, ast.comprehension)
+                  for target in ast.walk(comp.target)}
+        hoisted = []
+        for stmt in node.body:
+            if isinstance(stmt, ast.Assign):
+                targets = [t.id for t in stmt.targets if isinstance(t, ast.Name)]
+                seen.update(targets)
+                continue
+            for child in ast.walk(stmt):
+                if (isinstance(child, ast.Name) and isinstance(child.ctx, ast.Store) and child.id not in seen
+                        and child not in scoped):
+                    seen.add(child.id)
+                    hoisted.append(child.id)
+        return hoisted
+
+    def assign(self, target, value, cpp_type='auto'):
+        if target in self.declared:
+            self.c_code.append(f"{self.indent()}{target} = {value};")
+        else:
+            self.declared.add(target)
+            self.c_code.append(f"{self.indent()}{cpp_type} {target} = {value};")
+
+    def visit_value(self, node):
+        # Used where the C++ side takes the value by value or by rvalue
+        if node in self.movable:
+            return f"std::move({node.id})"
+        return self.visit(node)
+
+    def native_name(self, name):
+        return f"native_{name}"
+
+    def native_signature(self, node):
+        param_types, return_type = self.native[node.name]
+        params = ', '.join(f"{NATIVE_TYPES[t]} {arg.arg}" for arg, t in zip(node.args.args, param_types))
+        return f"{NATIVE_TYPES[return_type]} {self.native_name(node.name)}({params})"
+
+    def start_profile(self, node, entry, label):
+        if not self.profile:
+            return
+        if self.module:
+            label = f"{self.module.name}.{label}"
+        self.profile_entries.append((entry, label, node.lineno))
+        self.c_code.append(f"{self.indent()}PY_PROFILE({entry});")
+
+    def generate_profile_entries(self):
+        return [f"PY_PROFILE_ENTRY {entry}({cpp_string_literal(label)}, {line});"
+                for entry, label, line in self.profile_entries]
+
+    def type_site(self, kind, key):
+        var = f"py_types_{len(self.type_sites)}"
+        self.type_sites.append((var, kind, key))
+        return var
+
+    def generate_type_sites(self):
+        return [f"PY_TYPE_SITE {var}({cpp_string_literal(kind)}, {cpp_string_literal(key)});"
+                for var, kind, key in self.type_sites]
+
+    def binop_key(self, node):
+        # Identifies a binary-op site across the generating and the consuming pass
+        return f"{self.function_name}:{node.lineno}:{node.col_offset}-{node.end_col_offset}"
+
+    def record_arg_types(self, node):
+        params = [arg.arg for arg in node.args.args]
+        if self.type_profile_gen and params:
+            site = self.type_site('function', node.name)
+            self.c_code.append(f"{self.indent()}{site}.record({', '.join(params)});")
+
+    def emit_type_guard(self, node):
+        # Runs the native version when the arguments have its parameter
+        # types (inferred, or profiled for guarded functions), so boxed
+        # callers reach it whatever their own argument expressions are
+        if node.name not in self.native:
+            return
+        types = self.native[node.name][0]
+        checks, values = [], []
+        for arg, t in zip(node.args.args, types):
+            if t == 'int':
+                checks.append(f"{arg.arg}.is_int()")
+                values.append(f"{arg.arg}.int_value()")
+            else:
+                checks.append(f"{arg.arg}.type() == PY_OJ_Type::FLOAT")
+                values.append(f"{arg.arg}.float_value()")
+        self.c_code.append(f"{self.indent()}PY_NATIVE_FALLBACK py_fallback;")
+        self.c_code.append(f"{self.indent()}if (!PY_NATIVE_FALLBACK::active && {' && '.join(checks)}) {{")
+        self.c_code.append(f"{self.indent()}  PY_GUARDED_NATIVE(py_fallback, {self.native_name(node.name)}({', '.join(values)}))")
+        self.c_code.append(f"{self.indent()}}}")
+
+    def generate_prototypes(self):
+        return [f"{self.native_signature(self.inference.functions[name])};" for name in self.native]
+
+    def native_expr(self, node, env):
+        if isinstance(node, ast.Constant):
+            return float_literal(node.value) if isinstance(node.value, float) else int_literal(node.value)
+        if isinstance(node, ast.Name):
+            return node.id
+        if isinstance(node, ast.BinOp):
+            left = self.native_expr(node.left, env)
+            right = self.native_expr(node.right, env)
+            if isinstance(node.op, ast.Div):
+                return f"PY_NATIVE_DIV({left}, {right})"
+            # int64_t arithmetic is overflow-checked so the caller can fall
+            # back to boxed (bigint) code; float arithmetic is left as is
+            if self.inference.expr_type(node, env) == 'int':
+                helper = {ast.Add: 'PY_CHECKED_ADD', ast.Sub: 'PY_CHECKED_SUB', ast.Mult: 'PY_CHECKED_MULT'}[type(node.op)]
+                return f"{helper}({left}, {right})"
+            op = {ast.Add: '+', ast.Sub: '-', ast.Mult: '*'}[type(node.op)]
+            return f"({left} {op} {right})"
+        if isinstance(node, ast.UnaryOp):
+            if numeric_literal(node) is not None:
+                value = numeric_literal(node)
+                return float_literal(value) if isinstance(value, float) else int_literal(value)
+            operand = self.native_expr(node.operand, env)
+            if isinstance(node.op, ast.UAdd):
+                return f"(+{operand})"
+            if self.inference.expr_type(node, env) == 'int':
+                return f"PY_CHECKED_SUB(0, {operand})"
+            return f"(-{operand})"
+        if isinstance(node, ast.Compare):
+            op = {ast.Eq: '==', ast.NotEq: '!=', ast.Lt: '<', ast.LtE: '<=', ast.Gt: '>', ast.GtE: '>='}[type(node.ops[0])]
+            return f"{self.native_expr(node.left, env)} {op} {self.native_expr(node.comparators[0], env)}"
+        if isinstance(node, ast.Call):
+            args = ', '.join(self.native_expr(arg, env) for arg in node.args)
+            return f"{self.native_name(node.func.id)}({args})"
+        raise ValueError(f"not a native expression: {ast.dump(node)}")
+
+    def native_stmt(self, node, env):
+        if isinstance(node, ast.Assign):
+            # Spelled out: auto would make an int literal a 32-bit int
+            target = node.targets[0].id
+            self.assign(target, self.native_expr(node.value, env), NATIVE_TYPES[env[target]])
+        elif isinstance(node, ast.AugAssign):
+            value = self.native_expr(ast.BinOp(left=node.target, op=node.op, right=node.value), env)
+            self.c_code.append(f"{self.indent()}{node.target.id} = {value};")
+        elif isinstance(node, ast.For):
+            header, counter = self.range_loop_header(node, lambda arg: self.native_expr(arg, env), boxed=False)
+            self.emit_loop(header, f"{node.target.id} = {counter};", node.body, lambda stmt: self.native_stmt(stmt, env))
+        elif isinstance(node, ast.While):
+            self.emit_loop(f"while ({self.native_expr(node.test, env)})", None, node.body,
+                           lambda stmt: self.native_stmt(stmt, env))
+        elif isinstance(node, (ast.Break, ast.Continue)):
+            self.c_code.append(f"{self.indent()}{'break' if isinstance(node, ast.Break) else 'continue'};")
+        elif isinstance(node, ast.Return):
+            if self.tail:
+                helper = 'PY_CHECKED_ADD' if self.tail['op'] is ast.Add else 'PY_CHECKED_MULT'
+                self.emit_tail_return(node.value, lambda expr: self.native_expr(expr, env),
+                                      lambda a, b: f"{helper}({a}, {b})")
+            else:
+                self.c_code.append(f"{self.indent()}return {self.native_expr(node.value, env)};")
+        elif isinstance(node, ast.If):
+            self.c_code.append(f"{self.indent()}if ({self.native_expr(node.test, env)}) {{")
+            self.indent_level += 1
+            for stmt in node.body:
+                self.native_stmt(stmt, env)
+            self.indent_level -= 1
+            self.c_code.append(f"{self.indent()}}}")
+            if node.orelse:
+                self.c_code.append(f"{self.indent()}else {{")
+                self.indent_level += 1
+                for stmt in node.orelse:
+                    self.native_stmt(stmt, env)
+                self.indent_level -= 1
+                self.c_code.append(f"{self.indent()}}}")
+
+    def emit_native_function(self, node):
+        # Native bodies are typed by the inference that specialized them
+        static, self.inference = self.inference, self.native_inference
+        self.c_code.append(f"{self.indent()}{self.native_signature(node)} {{")
+        self.indent_level += 1
+        self.start_profile(node, f"py_profile_{self.native_name(node.name)}", f"{node.name} (native)")
+        env = self.inference.env(node.name)
+        self.start_tail_loop(node, [NATIVE_TYPES[t] for t in self.native[node.name][0]], 'int64_t')
+        self.declared = {arg.arg for arg in node.args.args}
+        for name in self.hoisted_locals(node):
+            self.declared.add(name)
+            self.c_code.append(f"{self.indent()}{NATIVE_TYPES[env[name]]} {name} = 0;")
+        for stmt in node.body:
+            self.native_stmt(stmt, env)
+        self.tail = None
+        self.indent_level -= 1
+        self.c_code.append(f"{self.indent()}}}")
+        self.inference = static
+
+    def tail_loop(self, node, acc_type):
+        """(tail, op) for the self-recursion of node that is lowered to a
+        loop. An accumulator (op) is only used for int functions, where +
+        and * are associative and commutative; memoized functions keep
+        their calls so every level goes through the cache. The boxed body
+        of an exported function returns whatever its unseen callers' types
+        make it, so only its guarded native version counts as int."""
+        if node.name in self.memoized or node.name == 'main':
+            return False, None
+        tail, op = tail_recursion(node)
+        returns = self.inference.returns[node.name]
+        if acc_type == 'PY_OJ' and node.name in self.exported:
+            returns = 'dyn'
+        if returns != 'int':
+            op = None
+        return tail, op
+
+    def start_tail_loop(self, node, param_types, acc_type):
+        # Emits the accumulator and the label self tail calls jump back to.
+        # The label comes before the locals, so each jump starts them afresh.
+        tail, op = self.tail_loop(node, acc_type)
+        if not tail and not op:
+            return
+        self.tail = {'func': node, 'op': op, 'types': param_types}
+        if op:
+            identity = 0 if op is ast.Add else 1
+            value = identity if acc_type != 'PY_OJ' else f"PY_OJ({identity})"
+            self.c_code.append(f"{self.indent()}{acc_type} py_acc = {value};")
+        self.c_code.append(f"{self.indent()}py_tail_call:")
+
+    def emit_tail_return(self, value, expr, combine):
+        """Emits `return value` in a function with a tail loop. expr renders
+        an expression and combine(a, b) applies the accumulator op."""
+        func, op = self.tail['func'], self.tail['op']
+        call = None
+        if is_self_call(value, func):
+            call = value
+        elif op and accumulator_form(value, func) and isinstance(value.op, op):
+            call, other = accumulator_form(value, func)
+            self.c_code.append(f"{self.indent()}py_acc = {combine('py_acc', expr(other))};")
+        if call is None:
+            result = combine('py_acc', expr(value)) if op else expr(value)
+            self.c_code.append(f"{self.indent()}return {result};")
+            return
+        # Every argument is evaluated before any parameter is reassigned
+        params = [arg.arg for arg in func.args.args]
+        changed = [(p, t, a) for p, t, a in zip(params, self.tail['types'], call.args)
+                   if not (isinstance(a, ast.Name) and a.id == p)]
+        if len(changed) == 1:
+            param, _, arg = changed[0]
+            self.c_code.append(f"{self.indent()}{param} = {expr(arg)};")
+        else:
+            for param, cpp_type, arg in changed:
+                self.c_code.append(f"{self.indent()}{cpp_type} py_next_{param} = {expr(arg)};")
+            for param, _, _ in changed:
+                self.c_code.append(f"{self.indent()}{param} = std::move(py_next_{param});")
+        self.c_code.append(f"{self.indent()}goto py_tail_call;")
+
+    def range_loop_header(self, node, expr, boxed):
+        # for i in range(...) becomes a counted loop over an int64_t counter;
+        # the loop variable is assigned from it at the top of each iteration,
+        # so it keeps its last value after the loop, as in Python
+        args = node.iter.args
+        n = self.loop_count
+        self.loop_count += 1
+        counter, stop = f"py_i{n}", f"py_stop{n}"
+        bound = (lambda arg: f"PY_RANGE_ARG({expr(arg)})") if boxed else expr
+        start_value = bound(args[0]) if len(args) > 1 else "0"
+        stop_value = bound(args[1] if len(args) > 1 else args[0])
+        step = numeric_literal(args[2]) if len(args) == 3 else 1
+        init = f"int64_t {counter} = {start_value}, {stop} = {stop_value}"
+        if type(step) is int and step != 0:
+            cond = f"{counter} {'<' if step > 0 else '>'} {stop}"
+            return f"for ({init}; {cond}; {counter} += {step})", counter
+        step_var = f"py_step{n}"
+        init += f", {step_var} = PY_RANGE_STEP({expr(args[2])})"
+        cond = f"({step_var} > 0 ? {counter} < {stop} : {counter} > {stop})"
+        return f"for ({init}; {cond}; {counter} += {step_var})", counter
+
+    def emit_loop(self, header, first, body, emit):
+        self.c_code.append(f"{self.indent()}{header} {{")
+        self.indent_level += 1
+        if first:
+            self.c_code.append(f"{self.indent()}{first}")
+        for stmt in body:
+            emit(stmt)
+        self.indent_level -= 1
+        self.c_code.append(f"{self.indent()}}}")
+
+    def native_call(self, node):
+        # Calls from boxed code whose arguments are literals, so their types
+        # are known here, go straight to the native version; other calls
+        # reach it through the boxed version's type guard. If the native
+        # int64_t arithmetic overflows, the boxed version reruns the call.
+        if not isinstance(node.func, ast.Name) or node.func.id not in self.native:
+            return None
+        if not self.inference.native_expr_ok(node, {}, self.native):
+            return None
+        boxed = f"{node.func.id}({', '.join(self.visit(arg) for arg in node.args)})"
+        return f"PY_NATIVE_CALL({self.native_expr(node, {})}, {boxed})"
+
+    def emit_memo_wrapper(self, node):
+        # name() looks the arguments up in its cache and only runs the
+        # original body, emitted as name_uncached(), on a miss. Recursive
+        # calls in the body go through name() and hit the cache too.
+        params = ', '.join(f'PY_OJ {arg.arg}' for arg in node.args.args)
+        args = ', '.join(arg.arg for arg in node.args.args)
+        self.c_code.append(f"{self.indent()}PY_OJ {node.name}_uncached({params});")
+        self.c_code.append(f"{self.indent()}PY_OJ {node.name}({params}) {{")
+        self.c_code.append(f"{self.indent()}  static PY_THREAD_LOCAL PY_MEMO<{len(node.args.args)}> memo;")
+        self.c_code.append(f"{self.indent()}  return memo.call({{{args}}}, [&] {{ return {node.name}_uncached({args}); }});")
+        self.c_code.append(f"{self.indent()}}}")
 
     def visit_FunctionDef(self, node):
+        if node.name in self.native:
+            self.emit_native_function(node)
+        self.movable = self.find_last_uses(node)
+        self.function_name = node.name
         if node.name == 'main':
             self.has_main = True
             self.c_code.append(f"{self.indent()}void py_main() {{")
+        elif node.name in self.memoized:
+            self.emit_memo_wrapper(node)
+            self.c_code.append(f"{self.indent()}PY_OJ {node.name}_uncached({', '.join(f'PY_OJ {arg.arg}' for arg in node.args.args)}) {{")
         else:
             return_type = "PY_OJ" if self.has_return(node) else "void"
             self.c_code.append(f"{self.indent()}{return_type} {node.name}({', '.join(f'PY_OJ {arg.arg}' for arg in node.args.args)}) {{")
         
         self.indent_level += 1
+        self.start_profile(node, f"py_profile_{node.name}", node.name)
+        # Scopes the arena allocator (-DPY_OJ_ALLOC_ARENA) to this call
+        self.c_code.append(f"{self.indent()}PY_CALL_FRAME();")
+        self.record_arg_types(node)
+        self.emit_type_guard(node)
+        self.start_tail_loop(node, ['PY_OJ'] * len(node.args.args), 'PY_OJ')
+        self.declared = {arg.arg for arg in node.args.args}
+        for name in self.hoisted_locals(node):
+            self.declared.add(name)
+            self.c_code.append(f"{self.indent()}PY_OJ {name};")
         for stmt in node.body:
             self.visit(stmt)
+        self.tail = None
         self.indent_level -= 1
         self.c_code.append(f"{self.indent()}}}")
 
     def visit_Assign(self, node):
+        if isinstance(node.targets[0], ast.Subscript) and isinstance(node.targets[0].slice, ast.Slice):
+            # Slice assignment is not supported
+            self.c_code.append(f"{self.indent()}{self.generic_visit(node)}")
+            return
+        if isinstance(node.targets[0], ast.Subscript):
+            # Case: my_list[i] = x, my_dict[key] = x
+            target = node.targets[0]
+            value = self.visit_value(node.value)
+            self.c_code.append(f"{self.indent()}PY_SETITEM({self.visit(target.value)}, {self.visit(target.slice)}, {value});")
+            return
         target = self.visit(node.targets[0])
-        value = self.visit(node.value)
-        self.c_code.append(f"{self.indent()}auto {target} = {value};")
+        self.move_reassigned(target, node.value)
+        value = self.visit_value(node.value)
+        self.assign(target, value)
+
+    def move_reassigned(self, target, value):
+        # In x = x + e the old x is dead once e is evaluated, so it is moved
+        # into PY_ADD, which can then append to a string in place. Not if e
+        # reads x as well.
+        if (target in self.declared and isinstance(value, ast.BinOp) and isinstance(value.op, ast.Add)
+                and isinstance(value.left, ast.Name) and value.left.id == target
+                and not any(isinstance(n, ast.Name) and n.id == target for n in ast.walk(value.right))):
+            self.movable.add(value.left)
 
     def visit_BinOp(self, node):
-        left = self.visit(node.left)
+        # + takes an rvalue left operand over, see PY_ADD(PY_OJ&&, ...)
+        left = self.visit_value(node.left) if isinstance(node.op, ast.Add) else self.visit(node.left)
         right = self.visit(node.right)
         op = {
             ast.Add: 'PY_ADD',
@@ -42,16 +925,44 @@ class PythonToCConverter(ast.NodeVisitor):
             ast.Mult: 'PY_MULT',
             ast.Div: 'PY_DIV'
         }.get(type(node.op), '?')
+        if self.type_profile_gen:
+            return f"py_type_binop({self.type_site('binop', self.binop_key(node))}, {op}, {left}, {right})"
+        types = self.binop_types.get(self.binop_key(node))
+        if types == ('float', 'float'):
+            op += '_FLOAT'
+        elif types == ('str', 'str') and isinstance(node.op, ast.Add):
+            op += '_STR'
         return f"{op}({left}, {right})"
 
+    def visit_UnaryOp(self, node):
+        if isinstance(node.op, ast.USub):
+            if isinstance(node.operand, ast.Constant) and isinstance(node.operand.value, (int, float)):
+                return self.visit_Constant(ast.Constant(-node.operand.value))
+            return f"PY_SUB({self.visit_Constant(ast.Constant(0))}, {self.visit(node.operand)})"
+        if isinstance(node.op, ast.UAdd):
+            return self.visit(node.operand)
+        return self.generic_visit(node)
+
     def visit_Return(self, node):
         if node.value is None:
             self.c_code.append(f"{self.indent()}return;")
+        elif self.tail:
+            helper = 'PY_ADD' if self.tail['op'] is ast.Add else 'PY_MULT'
+            self.emit_tail_return(node.value, self.visit_value, lambda a, b: f"{helper}({a}, {b})")
         else:
             self.c_code.append(f"{self.indent()}return {self.visit(node.value)};")
 
+    def condition(self, node):
+        # Comparisons already yield a C++ bool; anything else is tested for
+        # Python truthiness
+        if isinstance(node, ast.Compare):
+            return self.visit(node)
+        if isinstance(node, ast.Constant):
+            return 'true' if node.value else 'false'
+        return f"PY_TRUTH({self.visit(node)})"
+
     def visit_If(self, node):
-        condition = self.visit(node.test)
+        condition = self.condition(node.test)
         self.c_code.append(f"{self.indent()}if ({condition}) {{")
         self.indent_level += 1
         for stmt in node.body:
@@ -66,8 +977,74 @@ class PythonToCConverter(ast.NodeVisitor):
             self.indent_level -= 1
             self.c_code.append(f"{self.indent()}}}")
 
+    def visit_For(self, node):
+        if node.orelse or not isinstance(node.target, ast.Name):
+            self.c_code.append(f"{self.indent()}{self.generic_visit(node)}")
+            return
+        target = node.target.id
+        if is_range_loop(node, self.functions):
+            header, counter = self.range_loop_header(node, self.visit, boxed=True)
+            self.emit_loop(header, f"{target} = PY_OJ({counter});", node.body, self.visit)
+        else:
+            cursor = f"py_iter{self.loop_count}"
+            self.loop_count += 1
+            header = f"for (PY_ITER {cursor}({self.visit(node.iter)}); {cursor}.next({target}); )"
+            self.emit_loop(header, None, node.body, self.visit)
+
+    def visit_While(self, node):
+        if node.orelse:
+            self.c_code.append(f"{self.indent()}{self.generic_visit(node)}")
+            return
+        self.emit_loop(f"while ({self.condition(node.test)})", None, node.body, self.visit)
+
+    def visit_Break(self, node):
+        self.c_code.append(f"{self.indent()}break;")
+
+    def visit_Continue(self, node):
+        self.c_code.append(f"{self.indent()}continue;")
+
+    def visit_AugAssign(self, node):
+        if isinstance(node.target, ast.Subscript) and isinstance(node.target.slice, ast.Slice):
+            self.c_code.append(f"{self.indent()}{self.generic_visit(node)}")
+            return
+        if isinstance(node.target, ast.Subscript):
+            self.subscript_aug_assign(node)
+            return
+        target = self.visit(node.target)
+        binop = ast.BinOp(left=ast.Name(id=target, ctx=ast.Load()), op=node.op, right=node.value)
+        self.move_reassigned(target, binop)
+        value = self.visit(ast.copy_location(binop, node))
+        self.c_code.append(f"{self.indent()}{target} = {value};")
+
+    def subscript_aug_assign(self, node):
+        # c[k] += v reads and writes the same item, so the container and key
+        # are evaluated once, into temporaries unless they are plain names
+        # or constants
+        container, key = node.target.value, node.target.slice
+        simple = (ast.Name, ast.Constant)
+        scoped = not (isinstance(container, simple) and isinstance(key, simple))
+        if scoped:
+            self.c_code.append(f"{self.indent()}{{")
+            self.indent_level += 1
+            if not isinstance(container, simple):
+                self.c_code.append(f"{self.indent()}PY_OJ py_item_container = {self.visit(container)};")
+                container = ast.Name(id='py_item_container', ctx=ast.Load())
+            if not isinstance(key, simple):
+                self.c_code.append(f"{self.indent()}PY_OJ py_item_key = {self.visit(key)};")
+                key = ast.Name(id='py_item_key', ctx=ast.Load())
+        item = ast.Subscript(value=container, slice=key, ctx=ast.Load())
+        binop = ast.BinOp(left=item, op=node.op, right=node.value)
+        value = self.visit(ast.copy_location(binop, node))
+        self.c_code.append(f"{self.indent()}PY_SETITEM({self.visit(container)}, {self.visit(key)}, {value});")
+        if scoped:
+            self.indent_level -= 1
+            self.c_code.append(f"{self.indent()}}}")
+
     def visit_Compare(self, node):
         left = self.visit(node.left)
+        if isinstance(node.ops[0], (ast.In, ast.NotIn)):
+            test = f"PY_CONTAINS({self.visit(node.comparators[0])}, {left})"
+            return test if isinstance(node.ops[0], ast.In) else f"!{test}"
         op = {
             ast.Eq: 'std::equal_to<>()', 
             ast.NotEq: 'std::not_equal_to<>()',
@@ -80,6 +1057,9 @@ class PythonToCConverter(ast.NodeVisitor):
         return f"PY_COMPARE({left}, {op}, {right})"
 
     def visit_Call(self, node):
+        imported = self.imported_function(node.func)
+        if imported:
+            return f"{imported}({', '.join(self.visit_value(arg) for arg in node.args)})"
         func = self.visit(node.func)
         args = ', '.join(self.visit(arg) for arg in node.args)
         if func == 'print':
@@ -88,43 +1068,207 @@ class PythonToCConverter(ast.NodeVisitor):
             if isinstance(node.func, ast.Attribute):
                 # Case: my_list.append(4)
                 list_arg = self.visit(node.func.value)
-                item_arg = self.visit(node.args[0])
+                item_arg = self.visit_value(node.args[0])
                 return f'{func}({list_arg}, {item_arg})'
             else:
                 # Case: PY_LIST_APPEND(my_list, 4)
                 return f'{func}({args})'
+        elif func == 'PY_LIST_POP' and isinstance(node.func, ast.Attribute):
+            # Case: my_list.pop(), my_list.pop(i)
+            return f'{func}({", ".join([self.visit(node.func.value)] + [self.visit(arg) for arg in node.args])})'
+        elif func == 'PY_LIST_INSERT' and isinstance(node.func, ast.Attribute) and len(node.args) == 2:
+            # Case: my_list.insert(i, x); the item is moved in on its last use
+            list_arg = self.visit(node.func.value)
+            return f'{func}({list_arg}, {self.visit(node.args[0])}, {self.visit_value(node.args[1])})'
+        elif func == 'PY_LIST_COPY' and isinstance(node.func, ast.Attribute):
+            # Case: my_list.copy()
+            return f'{func}({self.visit(node.func.value)})'
+        elif func == 'PY_DICT_GET' and isinstance(node.func, ast.Attribute):
+            # Case: my_dict.get(key, default). my_dict.get(key) would give
+            # None for a missing key, and the runtime has no None value.
+            if len(node.args) != 2:
+                return self.generic_visit(node)
+            return f'{func}({self.visit(node.func.value)}, {args})'
+        elif func in BUILTINS and func not in self.functions:
+            if func in ('min', 'max') and len(node.args) > 1:
+                # min(a, b, ...) is min over the list of its arguments
+                args = self.visit_List(ast.List(elts=node.args))
+            return f"{BUILTINS[func]}({args})"
+        elif func in self.functions:
+            native = self.native_call(node)
+            if native:
+                return native
+            args = ', '.join(self.visit_value(arg) for arg in node.args)
         return f"{func}({args})"
 
+    def imported_function(self, func):
+        # C++ name of a function of another batch module, called either by
+        # its imported name or through an imported module: f(), mod.f()
+        if not self.module:
+            return None
+        if isinstance(func, ast.Name):
+            return self.module.imports.get(func.id) if func.id not in self.functions else None
+        if isinstance(func, ast.Attribute):
+            path = dotted_name(func.value)
+            if path in self.module.aliases:
+                return f"{self.module.aliases[path]}::{func.attr}"
+        return None
+
     def visit_Name(self, node):
         return node.id
 
     def visit_Constant(self, node):
-        if isinstance(node.value, float):
-            return f"PY_OJ({node.value}f)"
-        elif isinstance(node.value, int):
-            return f"PY_OJ({node.value})"
-        elif isinstance(node.value, str):
-            return f'PY_OJ("{node.value}")'
-        else:
-            return str(node.value)
+        value = node.value
+        if isinstance(value, bool):
+            return 'true' if value else 'false'
+        if isinstance(value, float):
+            return self.intern(('float', repr(value)), 'PY_FLOAT', float_literal(value))
+        if isinstance(value, int):
+            if INT64_MIN < value <= INT64_MAX:
+                name = f"PY_INT_{value}" if value >= 0 else f"PY_INT_M{-value}"
+                return self.intern(('int', value), name, int_literal(value), numbered=False)
+            return self.intern(('int', value), 'PY_BIG', f'PY_BIGINT("{value}")')
+        if isinstance(value, str):
+            return self.intern(('str', value), 'PY_STR', cpp_string_literal(value))
+        return str(value)
+
+    def intern(self, key, name, initializer, numbered=True):
+        if key not in self.constants:
+            if numbered:
+                name = f"{name}_{sum(1 for n, _ in self.constants.values() if n.startswith(name + '_'))}"
+            self.constants[key] = (name, initializer)
+        return self.constants[key][0]
+
+    def generate_constants(self):
+        return [f"static const PY_OJ {name}({initializer});" for name, initializer in self.constants.values()]
 
     def visit_Expr(self, node):
         expr = self.visit(node.value)
         self.c_code.append(f"{self.indent()}{expr};")
 
     def visit_List(self, node):
+        # All-int or all-float literal lists are built straight into the
+        # runtime's unboxed list storage
+        values = [numeric_literal(elt) for elt in node.elts]
+        if values and all(type(v) is int and INT64_MIN < v <= INT64_MAX for v in values):
+            return f"PY_OJ(std::vector<int64_t>{{{', '.join(int_literal(v) for v in values)}}})"
+        if values and all(type(v) is float for v in values):
+            return f"PY_OJ(std::vector<float>{{{', '.join(float_literal(v) for v in values)}}})"
         elements = [self.visit(elt) for elt in node.elts]
         return f"PY_OJ({{std::vector<PY_OJ>{{{', '.join(elements)}}}}})"
 
+    def visit_Dict(self, node):
+        if any(key is None for key in node.keys):
+            # {**other} unpacking
+            return self.generic_visit(node)
+        items = ', '.join(f"{{{self.visit(key)}, {self.visit(value)}}}" for key, value in zip(node.keys, node.values))
+        return f"PY_DICT({{{items}}})" if items else "PY_DICT()"
+
+    def visit_ListComp(self, node):
+        parallel = self.parallel_map(node)
+        if parallel:
+            return parallel
+        result = ast.Name(id=f"py_comp{self.loop_count}", ctx=ast.Load())
+        self.loop_count += 1
+        append = ast.Attribute(value=result, attr='append', ctx=ast.Load())
+        store = ast.Expr(value=ast.Call(func=append, args=[node.elt], keywords=[]))
+        return self.comprehension(node, result, "PY_OJ({std::vector<PY_OJ>{}})", store)
+
+    # Generator expressions are built as lists: the builtins they are passed
+    # to (sum, min, max, ...) consume every item anyway
+    visit_GeneratorExp = visit_ListComp
+
+    def visit_DictComp(self, node):
+        result = ast.Name(id=f"py_comp{self.loop_count}", ctx=ast.Load())
+        self.loop_count += 1
+        item = ast.Subscript(value=result, slice=node.key, ctx=ast.Store())
+        store = ast.Assign(targets=[item], value=node.value)
+        return self.comprehension(node, result, "PY_DICT()", store)
+
+    def comprehension(self, node, result, empty, store):
+        # A comprehension runs as the for loops and ifs it is written as,
+        # inside a lambda that is called on the spot and returns the result.
+        # The loop variables are the lambda's own, like the comprehension's
+        # scope in Python 3.
+        generators = node.generators
+        if any(gen.is_async or not isinstance(gen.target, ast.Name) for gen in generators):
+            return self.generic_visit(node)
+        body = [ast.copy_location(store, node)]
+        for gen in reversed(generators):
+            for cond in reversed(gen.ifs):
+                body = [ast.copy_location(ast.If(test=cond, body=body, orelse=[]), node)]
+            body = [ast.copy_location(ast.For(target=gen.target, iter=gen.iter, body=body, orelse=[]), node)]
+        targets = list(dict.fromkeys(gen.target.id for gen in generators))
+        outer = self.c_code
+        self.c_code = []
+        self.indent_level += 1
+        self.c_code.append(f"{self.indent()}PY_OJ {result.id} = {empty};")
+        self.c_code.append(f"{self.indent()}PY_OJ {', '.join(targets)};")
+        for stmt in body:
+            self.visit(stmt)
+        self.c_code.append(f"{self.indent()}return {result.id};")
+        self.indent_level -= 1
+        lines, self.c_code = self.c_code, outer
+        return "[&] {\n" + '\n'.join(lines) + f"\n{self.indent()}}}()"
+
+    def parallel_map(self, node):
+        # --parallel: [e for x in xs] whose e only calls pure functions runs
+        # as PY_PARALLEL_MAP (PY_PARALLEL_RANGE over a range), which maps the
+        # items on the runtime's thread pool and keeps their order
+        if not self.parallel or self.profile or self.type_profile_gen or len(node.generators) != 1:
+            return None
+        gen = node.generators[0]
+        if gen.ifs or gen.is_async or not isinstance(gen.target, ast.Name) or not self.parallel_safe(node.elt):
+            return None
+        body = f"[&](const PY_OJ& {gen.target.id}) -> PY_OJ {{ return {self.visit(node.elt)}; }}"
+        if not is_range_loop(gen, self.functions):
+            return f"PY_PARALLEL_MAP({self.visit(gen.iter)}, {body})"
+        args = gen.iter.args
+        start = f"PY_RANGE_ARG({self.visit(args[0])})" if len(args) > 1 else "0"
+        stop = f"PY_RANGE_ARG({self.visit(args[1] if len(args) > 1 else args[0])})"
+        step = f"PY_RANGE_STEP({self.visit(args[2])})" if len(args) == 3 else "1"
+        return f"PY_PARALLEL_RANGE({start}, {stop}, {step}, {body})"
+
+    def parallel_safe(self, node):
+        # Calls only to pure functions of the module and pure builtins, and no
+        # nested comprehension or lambda, whose loops would write shared state
+        for child in ast.walk(node):
+            if isinstance(child, ast.Call):
+                func = child.func
+                if not isinstance(func, ast.Name):
+                    return False
+                if func.id in self.functions:
+                    if func.id not in self.pure:
+                        return False
+                elif func.id not in PURE_BUILTINS or func.id == 'range':
+                    return False
+            elif isinstance(child, (ast.ListComp, ast.SetComp, ast.DictComp, ast.GeneratorExp,
+                                    ast.Lambda, ast.NamedExpr)):
+                return False
+        return True
+
     def visit_Subscript(self, node):
         value = self.visit(node.value)
+        if isinstance(node.slice, ast.Slice):
+            # Omitted bounds are passed as {}; the step only when given
+            parts = [node.slice.lower, node.slice.upper] + ([node.slice.step] if node.slice.step else [])
+            bounds = ', '.join(self.visit(part) if part else '{}' for part in parts)
+            return f"PY_SLICE({value}, {bounds})"
         index = self.visit(node.slice)
-        return f"PY_LIST_GET({value}, {index})"
+        return f"PY_GETITEM({value}, {index})"
 
     def visit_Attribute(self, node):
         value = self.visit(node.value)
         if node.attr == 'append':
             return f"PY_LIST_APPEND"
+        elif node.attr == 'pop':
+            return f"PY_LIST_POP"
+        elif node.attr == 'insert':
+            return f"PY_LIST_INSERT"
+        elif node.attr == 'copy':
+            return f"PY_LIST_COPY"
+        elif node.attr == 'get':
+            return f"PY_DICT_GET"
         # Add other list methods as needed
         return f"{value}.{node.attr}"
 
@@ -137,18 +1281,223 @@ class PythonToCConverter(ast.NodeVisitor):
         return f"/* Unhandled node type: {type(node).__name__} */"
 
     def generate_main(self):
-        self.c_code.append("int main() {")
-        self.c_code.append("    py_main();")
-        self.c_code.append("    return 0;")
-        self.c_code.append("}")
+        entry = f"{self.module.namespace}::py_main" if self.module else "py_main"
+        return ["int main() {", f"    {entry}();", "    return 0;", "}"]
 
-def python_to_c(python_code):
-    tree = ast.parse(python_code)
+# Python builtins implemented by the runtime, unless the module defines its own
+BUILTINS = {'len': 'PY_LEN', 'sum': 'PY_SUM', 'min': 'PY_MIN', 'max': 'PY_MAX'}
+
+def has_return(node):
+    return any(isinstance(stmt, ast.Return) for stmt in ast.walk(node))
+
+def dotted_name(node):
+    # "a.b.c" for a chain of attribute lookups on a name, else None
+    if isinstance(node, ast.Name):
+        return node.id
+    if isinstance(node, ast.Attribute):
+        base = dotted_name(node.value)
+        return base and f"{base}.{node.attr}"
+    return None
+
+def numeric_literal(node):
+    # Value of an int/float literal, including a negated one, else None
+    if isinstance(node, ast.UnaryOp) and isinstance(node.op, ast.USub):
+        value = numeric_literal(node.operand)
+        return None if value is None else -value
+    if isinstance(node, ast.Constant) and type(node.value) in (int, float):
+        return node.value
+    return None
+
+def int_literal(value):
+    # Literals wider than int must be spelled as int64_t to keep their value
+    if -2**31 <= value < 2**31:
+        return str(value)
+    return f"INT64_C({value})"
+
+def cpp_string_literal(value):
+    escapes = {'\\': '\\\\', '"': '\\"', '\n': '\\n', '\t': '\\t', '\r': '\\r'}
+    out = []
+    for byte in value.encode('utf-8'):
+        ch = chr(byte)
+        if ch in escapes:
+            out.append(escapes[ch])
+        elif 32 <= byte < 127:
+            out.append(ch)
+        else:
+            out.append(f"\\{byte:03o}")
+    return '"' + ''.join(out) + '"'
+
+def read_type_profile(path):
+    """Parses a profile written by a --type-profile-gen build into
+    {(kind, key): {type tuple: count}}."""
+    observed = {}
+    for line in read_file(path).splitlines():
+        if not line.strip():
+            continue
+        kind, key, types, count = line.split()
+        tuples = observed.setdefault((kind, key), {})
+        tuple_types = tuple(types.split(','))
+        tuples[tuple_types] = tuples.get(tuple_types, 0) + int(count)
+    return observed
+
+def monomorphic(tuples):
+    # The only type tuple a site was seen with, else None
+    return next(iter(tuples)) if len(tuples) == 1 else None
+
+def apply_type_profile(converter, tree, observed):
+    """Specializes the functions and binary-op sites that the profile only
+    saw with one combination of types. Functions whose arguments were
+    always ints/floats get a native version, entered behind a guard on
+    those types; the generic body stays as the fallback."""
+    assumed = {}
+    for (kind, key), tuples in observed.items():
+        types = monomorphic(tuples)
+        if types is None:
+            continue
+        if kind == 'binop':
+            converter.binop_types[key] = types
+        elif (kind == 'function' and key in converter.inference.functions
+              and key not in converter.memoized and key != 'main'
+              and len(types) == len(converter.inference.functions[key].args.args)
+              and all(t in NATIVE_TYPES for t in types)):
+            assumed[key] = types
+    if not assumed:
+        return
+    speculative = TypeInference(tree, assumed).run()
+    converter.native = speculative.specialize(exclude=converter.memoized)
+    converter.native_inference = speculative
+    converter.guarded = {name: types for name, types in assumed.items() if name in converter.native}
+
+def module_namespace(module):
+    # pkg.util -> py_module_pkg::py_module_util, one C++ namespace per module
+    return '::'.join(f"py_module_{part}" for part in module.split('.'))
+
+def module_interface(tree):
+    """Declarations of a module's functions, as other modules call them."""
+    decls = []
+    for node in tree.body:
+        if not isinstance(node, ast.FunctionDef):
+            continue
+        if node.name == 'main':
+            decls.append("void py_main();")
+            continue
+        return_type = 'PY_OJ' if has_return(node) else 'void'
+        decls.append(f"{return_type} {node.name}({', '.join(f'PY_OJ {arg.arg}' for arg in node.args.args)});")
+    return decls
+
+class BatchModule:
+    """A module transpiled as part of a batch (PY2-BATCH.py): its dotted name
+    and C++ namespace, the modules it depends on, the C++ names of the
+    functions it imports (local name -> qualified name) and of the modules
+    it imports (dotted name as written -> namespace), and whether it holds
+    the program's int main()."""
+
+    def __init__(self, name, is_package=False, entry=False):
+        self.name = name
+        self.is_package = is_package
+        self.entry = entry
+        self.namespace = module_namespace(name)
+        self.deps = []
+        self.imports = {}
+        self.aliases = {}
+
+    def resolve(self, level, target):
+        # Absolute name of `from <level dots><target> import ...`
+        if level == 0:
+            return target
+        parts = self.name.split('.')
+        base = parts[:len(parts) - level + (1 if self.is_package else 0)]
+        return '.'.join(base + ([target] if target else []))
+
+    def link(self, tree, functions):
+        """Resolves the module's imports against functions, {module name:
+        names of its functions} for every module of the batch. Raises
+        ValueError for an import of anything outside the batch."""
+        def depend(module):
+            if module not in functions:
+                raise ValueError(f"{self.name} imports {module}, which is not part of the batch")
+            if module not in self.deps and module != self.name:
+                self.deps.append(module)
+            return module_namespace(module)
+
+        for node in tree.body:
+            if isinstance(node, ast.Import):
+                for alias in node.names:
+                    namespace = depend(alias.name)
+                    self.aliases[alias.asname or alias.name] = namespace
+            elif isinstance(node, ast.ImportFrom):
+                source = self.resolve(node.level, node.module)
+                for alias in node.names:
+                    local = alias.asname or alias.name
+                    if f"{source}.{alias.name}" in functions:
+                        self.aliases[local] = depend(f"{source}.{alias.name}")
+                    elif alias.name in functions.get(source, ()):
+                        self.imports[local] = f"{depend(source)}::{alias.name}"
+                    else:
+                        raise ValueError(f"{self.name} imports {alias.name} from {source}, "
+                                         "which is not a function or module of the batch")
+        return self
+
+def convert_module(python_code, memo=False, profile=False, type_profile_gen=False, type_profile=None, module=None,
+                   parallel=False):
+    tree = ConstantFolder().fold(ast.parse(python_code))
     converter = PythonToCConverter()
+    converter.module = module
+    converter.profile = profile
+    converter.type_profile_gen = type_profile_gen
+    converter.functions = {node.name for node in tree.body if isinstance(node, ast.FunctionDef)}
+    if parallel:
+        converter.parallel = True
+        converter.pure = pure_functions(tree)
+    # Any function of a batch module can be imported by another module,
+    # including ones transpiled later against this module's cached output
+    if module is not None:
+        converter.exported = set(converter.functions)
+    converter.inference = TypeInference(tree).run()
+    if memo:
+        converter.memoized = {name for name in pure_functions(tree)
+                              if name != 'main' and converter.inference.functions[name].args.args
+                              and converter.has_return(converter.inference.functions[name])}
+    # Memoized functions stay boxed so every call goes through the cache
+    converter.native = converter.inference.specialize(exclude=converter.memoized)
+    converter.native_inference = converter.inference
+    if type_profile:
+        apply_type_profile(converter, tree, read_type_profile(type_profile))
     for node in tree.body:
         converter.visit(node)
-    converter.generate_main()
-    return '\n'.join(converter.c_code)
+    return converter
+
+def generate_cpp(converter):
+    header = []
+    for section in (converter.generate_constants(), converter.generate_profile_entries(),
+                    converter.generate_type_sites(), converter.generate_prototypes()):
+        if section:
+            header += section + [""]
+    module = converter.module
+    if module is None:
+        return '\n'.join(header + converter.c_code + converter.generate_main())
+    # A batch module's definitions live in its namespace, and only the entry
+    # module defines int main()
+    code = [f"namespace {module.namespace} {{", ""] + header + converter.c_code + ["", f"}} // namespace {module.namespace}"]
+    if module.entry:
+        code += [""] + converter.generate_main()
+    return '\n'.join(code)
+
+def python_to_c(python_code, **options):
+    return generate_cpp(convert_module(python_code, **options))
+
+def specialization_report(converter):
+    lines = ["Specialized functions:"]
+    for name, func in converter.inference.functions.items():
+        if name in converter.guarded:
+            lines.append(f"  {name}: {converter.native_signature(func)} (profile-guarded)")
+        elif name in converter.native:
+            lines.append(f"  {name}: {converter.native_signature(func)}")
+        elif name in converter.memoized:
+            lines.append(f"  {name}: PY_OJ (memoized)")
+        else:
+            lines.append(f"  {name}: PY_OJ (dynamic)")
+    return '\n'.join(lines)
 
 def read_file(file_path):
     with open(file_path, 'r') as file:
@@ -158,29 +1507,46 @@ def write_file(file_path, content):
     with open(file_path, 'w') as file:
         file.write(content)
 
-# Read from file
-input_file_path = 'PY-IN.py'  # Adjust this to your input file path
-python_code = read_file(input_file_path)
+def main():
+    parser = argparse.ArgumentParser(description="Transpile Python to C++ on top of the PY2.cpp runtime")
+    parser.add_argument('input', nargs='?', default='PY-IN.py', help="Python source (default: PY-IN.py)")
+    parser.add_argument('output', nargs='?', default='PY-OUT.cpp', help="generated C++ (default: PY-OUT.cpp)")
+    parser.add_argument('--memo', action='store_true',
+                        help="cache the results of pure functions, keyed on their arguments")
+    parser.add_argument('--profile', action='store_true',
+                        help="count and time every call, printing a per-function table to stderr at exit")
+    parser.add_argument('--type-profile-gen', action='store_true',
+                        help="record argument and operand types, written to $PY_TYPE_PROFILE at exit")
+    parser.add_argument('--type-profile', metavar='FILE',
+                        help="specialize the functions and operations FILE saw with a single type combination")
+    parser.add_argument('--parallel', action='store_true',
+                        help="map list comprehensions over pure expressions on a thread pool "
+                             "(build with -DPY_OJ_THREADS -pthread)")
+    args = parser.parse_args()
+
+    python_code = read_file(args.input)
 
-# Convert to C++
-cpp_code = python_to_c(python_code)
+    # Convert to C++
+    converter = convert_module(python_code, memo=args.memo, profile=args.profile,
+                               type_profile_gen=args.type_profile_gen, type_profile=args.type_profile,
+                               parallel=args.parallel)
+    cpp_code = generate_cpp(converter)
 
-# Add necessary includes and import test.cpp functionality
-cpp_code = '''#include <iostream>
-#include <string>
-#include <variant>
-#include <stdexcept>
-// Include PY.cpp functionality
-#include "PY2.cpp"
+    # The runtime's interface; the program links against PY2.cpp (or libpy2.a)
+    cpp_code = '''// Build with PY2.cpp or link libpy2.a, using the same -DPY_OJ_* flags
+#include "PY2.h"
 
 ''' + cpp_code
 
-# Write to output file
-output_file_path = 'PY-OUT.cpp'
-write_file(output_file_path, cpp_code)
-print(f"C++ code has been written to {output_file_path}")
-print(cpp_code)
+    # Write to output file
+    write_file(args.output, cpp_code)
+    print(f"C++ code has been written to {args.output}")
+    print(cpp_code)
+    print(specialization_report(converter))
+
+    # Print AST
+    tree = ast.parse(python_code)
+    print(ast.dump(tree))
 
-# Print AST
-tree = ast.parse(python_code)
-print(ast.dump(tree))
\ No newline at end of file
+if __name__ == '__main__':
+    main()
@@ -1,345 +1,1081 @@
+// Out-of-line half of the PY_OJ runtime declared in PY2.h: bigint
+// arithmetic, text formatting, the binary-op tables and the remaining slow
+// paths. Build it with the same -DPY_OJ_* flags as the programs it is
+// linked into, either alongside them or once as a library:
+//
+//   c++ -std=c++17 -O2 -c PY2.cpp -o PY2.o && ar rcs libpy2.a PY2.o
+#include "PY2.h"
+
+#include <charconv>
+#include <cmath>
 #include <iostream>
-#include <string>
-#include <variant>
-#include <stdexcept>
-#include <vector>
-#include <iomanip>
-#include <sstream>
-
-enum class PY_OJ_Type { INT, FLOAT, CHAR, STRING, LIST };
-
-struct PY_OJ {
-    union {
-        int i;
-        float f;
-        char c;
-        std::string* s;
-        std::vector<PY_OJ>* l;
-    };
-    PY_OJ_Type active_type;
-
-    PY_OJ() : i(0), active_type(PY_OJ_Type::INT) {}
-    PY_OJ(int val) : i(val), active_type(PY_OJ_Type::INT) {}
-    PY_OJ(float val) : f(val), active_type(PY_OJ_Type::FLOAT) {}
-    PY_OJ(char val) : c(val), active_type(PY_OJ_Type::CHAR) {}
-    PY_OJ(const std::string& val) : s(new std::string(val)), active_type(PY_OJ_Type::STRING) {}
-    PY_OJ(const std::vector<PY_OJ>& val) : l(new std::vector<PY_OJ>(val)), active_type(PY_OJ_Type::LIST) {}
-
-    ~PY_OJ() {
-        if (active_type == PY_OJ_Type::STRING) {
-            delete s;
-        } else if (active_type == PY_OJ_Type::LIST) {
-            delete l;
+#include <limits>
+#ifdef PY_OJ_THREADS
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif
+
+extern const int PY_RUNTIME_CONFIG = 1;
+
+#ifdef PY_OJ_COUNT_ALLOCS
+PY_OJ_ALLOC_STATS::~PY_OJ_ALLOC_STATS() {
+    std::cerr << "PY_OJ allocations: " << allocations
+              << ", deep copies: " << deep_copies
+              << ", moves: " << moves << std::endl;
+}
+#endif
+
+PY_BIGINT::PY_BIGINT(std::string_view digits) {
+    bool sign = !digits.empty() && digits[0] == '-';
+    if (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) digits.remove_prefix(1);
+    for (char digit : digits) {
+        if (digit < '0' || digit > '9') {
+            throw std::runtime_error("Invalid integer literal");
         }
+        mul_small(limbs, 10);
+        add_small(limbs, static_cast<uint32_t>(digit - '0'));
     }
+    negative = sign && !limbs.empty();
+}
 
-    PY_OJ(const PY_OJ& other) : active_type(other.active_type) {
-        switch (active_type) {
-            case PY_OJ_Type::INT: i = other.i; break;
-            case PY_OJ_Type::FLOAT: f = other.f; break;
-            case PY_OJ_Type::CHAR: c = other.c; break;
-            case PY_OJ_Type::STRING: s = new std::string(*other.s); break;
-            case PY_OJ_Type::LIST: l = new std::vector<PY_OJ>(*other.l); break;
-        }
+std::string PY_BIGINT::to_string() const {
+    if (limbs.empty()) return "0";
+    // Peel off base-10^9 chunks, least significant first
+    Limbs rest = limbs;
+    std::vector<uint32_t> chunks;
+    while (!rest.empty()) {
+        chunks.push_back(divmod_small(rest, 1000000000u));
     }
+    std::string out = negative ? "-" : "";
+    out += std::to_string(chunks.back());
+    for (size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string chunk = std::to_string(chunks[i]);
+        out.append(9 - chunk.size(), '0');
+        out += chunk;
+    }
+    return out;
+}
 
-    // Assignment operator
-    PY_OJ& operator=(const PY_OJ& other) {
-        if (this != &other) {
-            this->~PY_OJ(); // Call destructor to free any allocated memory
-            active_type = other.active_type;
-            switch (active_type) {
-                case PY_OJ_Type::INT: i = other.i; break;
-                case PY_OJ_Type::FLOAT: f = other.f; break;
-                case PY_OJ_Type::CHAR: c = other.c; break;
-                case PY_OJ_Type::STRING: s = new std::string(*other.s); break;
-                case PY_OJ_Type::LIST: l = new std::vector<PY_OJ>(*other.l); break;
-            }
-        }
-        return *this;
+size_t PY_BIGINT::hash() const {
+    size_t seed = negative;
+    for (uint32_t limb : limbs) {
+        seed ^= limb + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
     }
-};
+    return seed;
+}
 
-std::variant<int, float, char, std::string, std::vector<PY_OJ>> type_inference(const PY_OJ& obj) {
-    switch(obj.active_type) {
-        case PY_OJ_Type::INT: return obj.i;
-        case PY_OJ_Type::FLOAT: return obj.f;
-        case PY_OJ_Type::CHAR: return obj.c;
-        case PY_OJ_Type::STRING: return *obj.s;
-        case PY_OJ_Type::LIST: return *obj.l;
-        default: throw std::runtime_error("Unknown type");
-    }
-}
-
-std::string to_string(const std::variant<int, float, char, std::string, std::vector<PY_OJ>>& var) {
-    return std::visit([](auto&& arg) -> std::string {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr (std::is_same_v<T, int>) {
-            return std::to_string(arg);
-        } else if constexpr (std::is_same_v<T, float>) {
-            std::ostringstream oss;
-            oss << std::fixed << std::setprecision(6) << arg;
-            std::string str = oss.str();
-            str.erase(str.find_last_not_of('0') + 1, std::string::npos);
-            if (str.back() == '.') str.pop_back();
-            return str;
-        } else if constexpr (std::is_same_v<T, char>) {
-            return std::string(1, arg);
-        } else if constexpr (std::is_same_v<T, std::string>) {
-            return "\"" + arg + "\"";
-        } else if constexpr (std::is_same_v<T, std::vector<PY_OJ>>) {
-            std::string result = "[";
-            for (size_t i = 0; i < arg.size(); ++i) {
-                result += to_string(type_inference(arg[i]));
-                if (i < arg.size() - 1) result += ", ";
-            }
-            result += "]";
-            return result;
-        } else {
-            throw std::runtime_error("Unsupported type in to_string");
-        }
-    }, var);
+PY_BIGINT PY_BIGINT::operator-() const {
+    PY_BIGINT result = *this;
+    result.negative = !negative && !limbs.empty();
+    return result;
 }
 
-PY_OJ PY_ADD(const PY_OJ& a, const PY_OJ& b) {
-    auto type_a = type_inference(a);
-    auto type_b = type_inference(b);
+PY_BIGINT operator+(const PY_BIGINT& a, const PY_BIGINT& b) {
+    if (a.negative == b.negative) {
+        return PY_BIGINT(a.negative, PY_BIGINT::add_mag(a.limbs, b.limbs));
+    }
+    int order = PY_BIGINT::compare_mag(a.limbs, b.limbs);
+    if (order == 0) return PY_BIGINT();
+    if (order > 0) return PY_BIGINT(a.negative, PY_BIGINT::sub_mag(a.limbs, b.limbs));
+    return PY_BIGINT(b.negative, PY_BIGINT::sub_mag(b.limbs, a.limbs));
+}
 
-    if (std::holds_alternative<std::string>(type_a) || std::holds_alternative<std::string>(type_b) ||
-        std::holds_alternative<char>(type_a) || std::holds_alternative<char>(type_b)) {
-        return PY_OJ(to_string(type_a) + to_string(type_b));
-    } else if (std::holds_alternative<float>(type_a) || std::holds_alternative<float>(type_b)) {
-        float a_val = std::holds_alternative<float>(type_a) ? std::get<float>(type_a) : std::get<int>(type_a);
-        float b_val = std::holds_alternative<float>(type_b) ? std::get<float>(type_b) : std::get<int>(type_b);
-        return PY_OJ(a_val + b_val);
-    } else {
-        return PY_OJ(std::get<int>(type_a) + std::get<int>(type_b));
-    }
-}
-
-PY_OJ PY_SUB(const PY_OJ& a, const PY_OJ& b) {
-    auto type_a = type_inference(a);
-    auto type_b = type_inference(b);
-
-    if (std::holds_alternative<float>(type_a) || std::holds_alternative<float>(type_b)) {
-        float a_val = std::holds_alternative<float>(type_a) ? std::get<float>(type_a) : 
-                      (std::holds_alternative<int>(type_a) ? std::get<int>(type_a) : 
-                      static_cast<float>(std::get<char>(type_a)));
-        float b_val = std::holds_alternative<float>(type_b) ? std::get<float>(type_b) : 
-                      (std::holds_alternative<int>(type_b) ? std::get<int>(type_b) : 
-                      static_cast<float>(std::get<char>(type_b)));
-        return PY_OJ(a_val - b_val);
-    } else if (std::holds_alternative<int>(type_a) && std::holds_alternative<int>(type_b)) {
-        return PY_OJ(std::get<int>(type_a) - std::get<int>(type_b));
-    } else if (std::holds_alternative<char>(type_a) && std::holds_alternative<char>(type_b)) {
-        return PY_OJ(static_cast<int>(std::get<char>(type_a)) - static_cast<int>(std::get<char>(type_b)));
-    } else {
-        throw std::runtime_error("Unsupported types for subtraction");
+PY_BIGINT operator-(const PY_BIGINT& a, const PY_BIGINT& b) {
+    return a + (-b);
+}
+
+PY_BIGINT operator*(const PY_BIGINT& a, const PY_BIGINT& b) {
+    return PY_BIGINT(a.negative != b.negative, PY_BIGINT::mul_mag(a.limbs, b.limbs));
+}
+
+int compare(const PY_BIGINT& a, const PY_BIGINT& b) {
+    if (a.negative != b.negative) return a.negative ? -1 : 1;
+    int order = PY_BIGINT::compare_mag(a.limbs, b.limbs);
+    return a.negative ? -order : order;
+}
+
+bool operator==(const PY_BIGINT& a, const PY_BIGINT& b) {
+    return a.negative == b.negative && a.limbs == b.limbs;
+}
+
+void PY_BIGINT::trim(Limbs& mag) {
+    while (!mag.empty() && mag.back() == 0) mag.pop_back();
+}
+
+int PY_BIGINT::compare_mag(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+    for (size_t i = a.size(); i-- > 0;) {
+        if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
     }
+    return 0;
 }
 
-PY_OJ PY_MULT(const PY_OJ& a, const PY_OJ& b) {
-    auto type_a = type_inference(a);
-    auto type_b = type_inference(b);
-    
-    if (std::holds_alternative<std::string>(type_a) && std::holds_alternative<int>(type_b)) {
-        std::string str = std::get<std::string>(type_a);
-        int repeats = std::get<int>(type_b);
-        std::string result;
-        for (int i = 0; i < repeats; ++i) {
-            result += str;
-        }
-        return PY_OJ(result);
-    } else if (std::holds_alternative<int>(type_a) && std::holds_alternative<std::string>(type_b)) {
-        std::string str = std::get<std::string>(type_b);
-        int repeats = std::get<int>(type_a);
-        std::string result;
-        for (int i = 0; i < repeats; ++i) {
-            result += str;
-        }
-        return PY_OJ(result);
-    } else if (std::holds_alternative<float>(type_a) || std::holds_alternative<float>(type_b)) {
-        float a_val = std::holds_alternative<float>(type_a) ? std::get<float>(type_a) : 
-                      (std::holds_alternative<int>(type_a) ? std::get<int>(type_a) : 
-                      static_cast<float>(std::get<char>(type_a)));
-        float b_val = std::holds_alternative<float>(type_b) ? std::get<float>(type_b) : 
-                      (std::holds_alternative<int>(type_b) ? std::get<int>(type_b) : 
-                      static_cast<float>(std::get<char>(type_b)));
-        return PY_OJ(a_val * b_val);
-    } else if (std::holds_alternative<int>(type_a) && std::holds_alternative<int>(type_b)) {
-        return PY_OJ(std::get<int>(type_a) * std::get<int>(type_b));
-    } else if (std::holds_alternative<char>(type_a) && std::holds_alternative<char>(type_b)) {
-        return PY_OJ(static_cast<int>(std::get<char>(type_a)) * static_cast<int>(std::get<char>(type_b)));
-    } else {
-        throw std::runtime_error("Unsupported types for multiplication");
+void PY_BIGINT::mul_small(Limbs& mag, uint32_t factor) {
+    uint64_t carry = 0;
+    for (uint32_t& limb : mag) {
+        uint64_t cur = static_cast<uint64_t>(limb) * factor + carry;
+        limb = static_cast<uint32_t>(cur);
+        carry = cur >> 32;
+    }
+    if (carry) mag.push_back(static_cast<uint32_t>(carry));
+}
+
+void PY_BIGINT::add_small(Limbs& mag, uint32_t addend) {
+    uint64_t carry = addend;
+    for (size_t i = 0; carry && i < mag.size(); ++i) {
+        uint64_t cur = static_cast<uint64_t>(mag[i]) + carry;
+        mag[i] = static_cast<uint32_t>(cur);
+        carry = cur >> 32;
+    }
+    if (carry) mag.push_back(static_cast<uint32_t>(carry));
+}
+
+uint32_t PY_BIGINT::divmod_small(Limbs& mag, uint32_t divisor) {
+    uint64_t rem = 0;
+    for (size_t i = mag.size(); i-- > 0;) {
+        uint64_t cur = (rem << 32) | mag[i];
+        mag[i] = static_cast<uint32_t>(cur / divisor);
+        rem = cur % divisor;
+    }
+    trim(mag);
+    return static_cast<uint32_t>(rem);
+}
+
+PY_BIGINT::Limbs PY_BIGINT::add_mag(const Limbs& a, const Limbs& b) {
+    const Limbs& longer = a.size() >= b.size() ? a : b;
+    const Limbs& shorter = a.size() >= b.size() ? b : a;
+    Limbs result(longer.size() + 1);
+    uint64_t carry = 0;
+    for (size_t i = 0; i < longer.size(); ++i) {
+        uint64_t cur = static_cast<uint64_t>(longer[i]) + (i < shorter.size() ? shorter[i] : 0) + carry;
+        result[i] = static_cast<uint32_t>(cur);
+        carry = cur >> 32;
+    }
+    result[longer.size()] = static_cast<uint32_t>(carry);
+    trim(result);
+    return result;
+}
+
+PY_BIGINT::Limbs PY_BIGINT::sub_mag(const Limbs& a, const Limbs& b) {
+    Limbs result(a.size());
+    int64_t borrow = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        int64_t cur = static_cast<int64_t>(a[i]) - (i < b.size() ? b[i] : 0) - borrow;
+        borrow = cur < 0;
+        result[i] = static_cast<uint32_t>(cur + (borrow << 32));
     }
+    trim(result);
+    return result;
 }
 
-PY_OJ PY_DIV(const PY_OJ& a, const PY_OJ& b) {
-    auto type_a = type_inference(a);
-    auto type_b = type_inference(b);
+void PY_BIGINT::add_shifted(Limbs& dst, const Limbs& src, size_t offset) {
+    uint64_t carry = 0;
+    size_t i = 0;
+    for (; i < src.size(); ++i) {
+        uint64_t cur = static_cast<uint64_t>(dst[offset + i]) + src[i] + carry;
+        dst[offset + i] = static_cast<uint32_t>(cur);
+        carry = cur >> 32;
+    }
+    for (size_t j = offset + i; carry && j < dst.size(); ++j) {
+        uint64_t cur = static_cast<uint64_t>(dst[j]) + carry;
+        dst[j] = static_cast<uint32_t>(cur);
+        carry = cur >> 32;
+    }
+}
 
-    if (std::holds_alternative<float>(type_a) || std::holds_alternative<float>(type_b)) {
-        float a_val = std::holds_alternative<float>(type_a) ? std::get<float>(type_a) : 
-                      (std::holds_alternative<int>(type_a) ? std::get<int>(type_a) : 
-                      static_cast<float>(std::get<char>(type_a)));
-        float b_val = std::holds_alternative<float>(type_b) ? std::get<float>(type_b) : 
-                      (std::holds_alternative<int>(type_b) ? std::get<int>(type_b) : 
-                      static_cast<float>(std::get<char>(type_b)));
-        if (b_val == 0) {
-            throw std::runtime_error("Division by zero");
+PY_BIGINT::Limbs PY_BIGINT::mul_schoolbook(const Limbs& a, const Limbs& b) {
+    Limbs result(a.size() + b.size());
+    for (size_t i = 0; i < a.size(); ++i) {
+        uint64_t carry = 0;
+        for (size_t j = 0; j < b.size(); ++j) {
+            uint64_t cur = static_cast<uint64_t>(a[i]) * b[j] + result[i + j] + carry;
+            result[i + j] = static_cast<uint32_t>(cur);
+            carry = cur >> 32;
         }
-        return PY_OJ(a_val / b_val);
-    } else if (std::holds_alternative<int>(type_a) && std::holds_alternative<int>(type_b)) {
-        int b_val = std::get<int>(type_b);
-        if (b_val == 0) {
-            throw std::runtime_error("Division by zero");
+        result[i + b.size()] = static_cast<uint32_t>(carry);
+    }
+    trim(result);
+    return result;
+}
+
+PY_BIGINT::Limbs PY_BIGINT::mul_mag(const Limbs& a, const Limbs& b) {
+    if (a.empty() || b.empty()) return Limbs();
+    if (a.size() < KARATSUBA_THRESHOLD || b.size() < KARATSUBA_THRESHOLD) {
+        return mul_schoolbook(a, b);
+    }
+    size_t m = std::max(a.size(), b.size()) / 2;
+    auto low = [m](const Limbs& x) {
+        Limbs part(x.begin(), x.begin() + std::min(m, x.size()));
+        trim(part);
+        return part;
+    };
+    auto high = [m](const Limbs& x) {
+        return x.size() > m ? Limbs(x.begin() + m, x.end()) : Limbs();
+    };
+    Limbs a0 = low(a), a1 = high(a), b0 = low(b), b1 = high(b);
+    Limbs z0 = mul_mag(a0, b0);
+    Limbs z2 = mul_mag(a1, b1);
+    Limbs z1 = mul_mag(add_mag(a0, a1), add_mag(b0, b1));
+    z1 = sub_mag(sub_mag(z1, z0), z2);
+
+    Limbs result(a.size() + b.size() + 1);
+    add_shifted(result, z0, 0);
+    add_shifted(result, z1, m);
+    add_shifted(result, z2, 2 * m);
+    trim(result);
+    return result;
+}
+
+// Lists and dicts currently being printed or converted to text. One that
+// contains itself is written as [...] or {...}, like CPython, instead of
+// recursing forever.
+static PY_THREAD_LOCAL std::vector<const void*> py_repr_stack;
+
+static bool py_repr_enter(const void* container) {
+    for (const void* active : py_repr_stack) {
+        if (active == container) return false;
+    }
+    py_repr_stack.push_back(container);
+    return true;
+}
+
+static void py_append_int(std::string& out, int64_t value) {
+    char buf[24];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+// Python's repr() of a float: the shortest digits that read back as the
+// same value, in fixed notation for exponents -4..15 and scientific notation
+// otherwise, always with a '.0' or an exponent so it still reads as a float.
+static void py_append_float(std::string& out, float value) {
+    if (std::isnan(value)) {
+        out += "nan";
+        return;
+    }
+    if (std::isinf(value)) {
+        out += value < 0 ? "-inf" : "inf";
+        return;
+    }
+    // Shortest round-trip digits as [-]d[.ddd]e(+|-)XX
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value, std::chars_format::scientific);
+    const char* p = buf;
+    if (*p == '-') {
+        out += '-';
+        ++p;
+    }
+    char digits[16];
+    size_t count = 0;
+    for (; *p != 'e'; ++p) {
+        if (*p != '.') digits[count++] = *p;
+    }
+    ++p;
+    bool negative_exponent = *p++ == '-';
+    int exponent = 0;
+    std::from_chars(p, result.ptr, exponent);
+    if (negative_exponent) exponent = -exponent;
+
+    if (exponent < -4 || exponent >= 16) {
+        out += digits[0];
+        if (count > 1) {
+            out += '.';
+            out.append(digits + 1, count - 1);
         }
-        return PY_OJ(static_cast<float>(std::get<int>(type_a)) / static_cast<float>(b_val));
+        out += negative_exponent ? "e-" : "e+";
+        if (std::abs(exponent) < 10) out += '0';
+        py_append_int(out, std::abs(exponent));
+    } else if (exponent < 0) {
+        out += "0.";
+        out.append(-exponent - 1, '0');
+        out.append(digits, count);
+    } else if (count <= static_cast<size_t>(exponent) + 1) {
+        out.append(digits, count);
+        out.append(exponent + 1 - count, '0');
+        out += ".0";
     } else {
-        throw std::runtime_error("Unsupported types for division");
+        out.append(digits, exponent + 1);
+        out += '.';
+        out.append(digits + exponent + 1, count - exponent - 1);
     }
 }
 
-PY_OJ PY_LIST_APPEND(PY_OJ& list, const PY_OJ& item) {
-    if (list.active_type != PY_OJ_Type::LIST) {
-        throw std::runtime_error("Append can only be used on lists");
+// Python's repr() of a string, used for strings nested in a list.
+static void py_append_repr(std::string& out, std::string_view str) {
+    char quote = (str.find('\'') != std::string_view::npos && str.find('"') == std::string_view::npos) ? '"' : '\'';
+    out += quote;
+    for (unsigned char c : str) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            default:
+                if (c == static_cast<unsigned char>(quote)) {
+                    out += '\\';
+                    out += quote;
+                } else if (c < 0x20 || c == 0x7f) {
+                    const char* hex = "0123456789abcdef";
+                    out += "\\x";
+                    out += hex[c >> 4];
+                    out += hex[c & 0xf];
+                } else {
+                    out += static_cast<char>(c);
+                }
+        }
     }
-    // Create a copy of the item to be appended
-    PY_OJ item_copy;
-    switch (item.active_type) {
+    out += quote;
+}
+
+// Appends the textual form of obj to out, as Python's str() would (repr()
+// for elements nested in a list or dict). Lists are walked in place,
+// without copying or boxing their elements.
+void py_append_text(std::string& out, const PY_OJ& obj, bool nested) {
+    switch (obj.type()) {
         case PY_OJ_Type::INT:
-            item_copy = PY_OJ(item.i);
-            break;
-        case PY_OJ_Type::FLOAT:
-            item_copy = PY_OJ(item.f);
+            if (obj.is_big_int()) {
+                out += obj.big_value().to_string();
+            } else {
+                py_append_int(out, obj.int_value());
+            }
             break;
+        case PY_OJ_Type::FLOAT: py_append_float(out, obj.float_value()); break;
         case PY_OJ_Type::CHAR:
-            item_copy = PY_OJ(item.c);
+            if (nested) {
+                char c = obj.char_value();
+                py_append_repr(out, std::string_view(&c, 1));
+            } else {
+                out += obj.char_value();
+            }
             break;
         case PY_OJ_Type::STRING:
-            item_copy = PY_OJ(*item.s);
+            if (nested) {
+                py_append_repr(out, obj.str_view());
+            } else {
+                out += obj.str_view();
+            }
             break;
-        case PY_OJ_Type::LIST:
-            item_copy = PY_OJ(*item.l);
+        case PY_OJ_Type::LIST: {
+            if (!py_repr_enter(obj.list_obj())) {
+                out += "[...]";
+                break;
+            }
+            PY_LIST_SPAN span = obj.list_obj()->span();
+            out += '[';
+            for (size_t i = 0; i < span.size; ++i) {
+                if (i > 0) out += ", ";
+                switch (span.kind) {
+                    case PY_LIST_KIND::INTS: py_append_int(out, span.ints()[i]); break;
+                    case PY_LIST_KIND::FLOATS: py_append_float(out, span.floats()[i]); break;
+                    case PY_LIST_KIND::BOXED: py_append_text(out, span.items()[i], true); break;
+                    default: py_append_text(out, span.get(i), true); break;
+                }
+            }
+            out += ']';
+            py_repr_stack.pop_back();
             break;
+        }
+        case PY_OJ_Type::DICT: {
+            if (!py_repr_enter(obj.dict_obj())) {
+                out += "{...}";
+                break;
+            }
+            out += '{';
+            bool first = true;
+            for (const PY_DICT_ENTRY& entry : obj.dict_obj()->entries) {
+                if (!first) out += ", ";
+                first = false;
+                py_append_text(out, entry.key, true);
+                out += ": ";
+                py_append_text(out, entry.value, true);
+            }
+            out += '}';
+            py_repr_stack.pop_back();
+            break;
+        }
     }
-    list.l->push_back(item_copy);
-    return PY_OJ(); // Return None
 }
 
-// Add this function to PY2.cpp
+void py_key_error(const PY_OJ& key) {
+    std::string message = "KeyError: ";
+    py_append_text(message, key, true);
+    throw std::runtime_error(message);
+}
+
+void PY_DICT_OBJ::rehash(size_t capacity) {
+    ctrl.assign(capacity, EMPTY);
+    slots.assign(capacity, 0);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        place(entries[i].hash, static_cast<uint32_t>(i));
+    }
+}
+
+// INT handlers stay on int64_t while the result fits and fall back to
+// PY_BIGINT arithmetic on overflow or when either operand is already big.
+static PY_OJ py_add_int(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_add_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return PY_OJ(py_as_bigint(a) + py_as_bigint(b));
+}
+static PY_OJ py_add_float(const PY_OJ& a, const PY_OJ& b) { return PY_OJ(py_as_float(a) + py_as_float(b)); }
+static PY_OJ py_add_concat(const PY_OJ& a, const PY_OJ& b) {
+    if (py_is_text(a) && py_is_text(b)) {
+        char left, right;
+        return py_concat(py_text_bytes(a, left), py_text_bytes(b, right));
+    }
+    std::string result;
+    py_append_text(result, a);
+    py_append_text(result, b);
+    return PY_OJ(result);
+}
+static PY_OJ py_add_fail(const PY_OJ&, const PY_OJ&) { throw std::runtime_error("Unsupported types for addition"); }
+
+static PY_OJ py_sub_int(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_sub_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return PY_OJ(py_as_bigint(a) - py_as_bigint(b));
+}
+static PY_OJ py_sub_float(const PY_OJ& a, const PY_OJ& b) { return PY_OJ(py_as_float(a) - py_as_float(b)); }
+static PY_OJ py_sub_char(const PY_OJ& a, const PY_OJ& b) { return PY_OJ(static_cast<int>(a.char_value()) - static_cast<int>(b.char_value())); }
+static PY_OJ py_sub_fail(const PY_OJ&, const PY_OJ&) { throw std::runtime_error("Unsupported types for subtraction"); }
+
+static PY_OJ py_mult_int(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_mul_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return PY_OJ(py_as_bigint(a) * py_as_bigint(b));
+}
+static PY_OJ py_mult_float(const PY_OJ& a, const PY_OJ& b) { return PY_OJ(py_as_float(a) * py_as_float(b)); }
+static PY_OJ py_mult_char(const PY_OJ& a, const PY_OJ& b) { return PY_OJ(static_cast<int>(a.char_value()) * static_cast<int>(b.char_value())); }
+static PY_OJ py_repeat(std::string_view str, const PY_OJ& count) {
+    if (count.is_big_int()) {
+        if (count.big_value().is_negative()) return PY_OJ("");
+        throw std::runtime_error("Repeat count too large");
+    }
+    if (count.int_value() <= 0 || str.empty()) return PY_OJ("");
+    size_t times = static_cast<size_t>(count.int_value());
+    if (times > std::numeric_limits<size_t>::max() / str.size()) {
+        throw std::runtime_error("Repeat count too large");
+    }
+    // One exact-size result; the copied prefix doubles on every pass
+    return py_make_string(str.size() * times, [&](char* out) {
+        size_t size = str.size() * times;
+        std::memcpy(out, str.data(), str.size());
+        for (size_t done = str.size(); done < size; done *= 2) {
+            std::memcpy(out + done, out, std::min(done, size - done));
+        }
+    });
+}
+static PY_OJ py_mult_str_int(const PY_OJ& a, const PY_OJ& b) { return py_repeat(a.str_view(), b); }
+static PY_OJ py_mult_int_str(const PY_OJ& a, const PY_OJ& b) { return py_repeat(b.str_view(), a); }
+static PY_OJ py_mult_fail(const PY_OJ&, const PY_OJ&) { throw std::runtime_error("Unsupported types for multiplication"); }
+
+static PY_OJ py_div_float(const PY_OJ& a, const PY_OJ& b) {
+    float b_val = py_as_float(b);
+    if (b_val == 0) {
+        throw std::runtime_error("Division by zero");
+    }
+    return PY_OJ(py_as_float(a) / b_val);
+}
+static PY_OJ py_div_int(const PY_OJ& a, const PY_OJ& b) {
+    if (b.is_int() && b.int_value() == 0) {
+        throw std::runtime_error("Division by zero");
+    }
+    double a_val = a.is_big_int() ? a.big_value().to_double() : static_cast<double>(a.int_value());
+    double b_val = b.is_big_int() ? b.big_value().to_double() : static_cast<double>(b.int_value());
+    return PY_OJ(static_cast<float>(a_val / b_val));
+}
+static PY_OJ py_div_fail(const PY_OJ&, const PY_OJ&) { throw std::runtime_error("Unsupported types for division"); }
+
+// Rows are the lhs type, columns the rhs type: INT, FLOAT, CHAR, STRING, LIST, DICT.
+extern const PY_BINOP_TABLE PY_ADD_TABLE = {
+    { py_add_int,    py_add_float,  py_add_concat, py_add_concat, py_add_fail,   py_add_fail   },
+    { py_add_float,  py_add_float,  py_add_concat, py_add_concat, py_add_fail,   py_add_fail   },
+    { py_add_concat, py_add_concat, py_add_concat, py_add_concat, py_add_concat, py_add_concat },
+    { py_add_concat, py_add_concat, py_add_concat, py_add_concat, py_add_concat, py_add_concat },
+    { py_add_fail,   py_add_fail,   py_add_concat, py_add_concat, py_add_fail,   py_add_fail   },
+    { py_add_fail,   py_add_fail,   py_add_concat, py_add_concat, py_add_fail,   py_add_fail   },
+};
+
+extern const PY_BINOP_TABLE PY_SUB_TABLE = {
+    { py_sub_int,   py_sub_float, py_sub_fail,  py_sub_fail, py_sub_fail, py_sub_fail },
+    { py_sub_float, py_sub_float, py_sub_float, py_sub_fail, py_sub_fail, py_sub_fail },
+    { py_sub_fail,  py_sub_float, py_sub_char,  py_sub_fail, py_sub_fail, py_sub_fail },
+    { py_sub_fail,  py_sub_fail,  py_sub_fail,  py_sub_fail, py_sub_fail, py_sub_fail },
+    { py_sub_fail,  py_sub_fail,  py_sub_fail,  py_sub_fail, py_sub_fail, py_sub_fail },
+    { py_sub_fail,  py_sub_fail,  py_sub_fail,  py_sub_fail, py_sub_fail, py_sub_fail },
+};
+
+extern const PY_BINOP_TABLE PY_MULT_TABLE = {
+    { py_mult_int,     py_mult_float, py_mult_fail,  py_mult_int_str, py_mult_fail, py_mult_fail },
+    { py_mult_float,   py_mult_float, py_mult_float, py_mult_fail,    py_mult_fail, py_mult_fail },
+    { py_mult_fail,    py_mult_float, py_mult_char,  py_mult_fail,    py_mult_fail, py_mult_fail },
+    { py_mult_str_int, py_mult_fail,  py_mult_fail,  py_mult_fail,    py_mult_fail, py_mult_fail },
+    { py_mult_fail,    py_mult_fail,  py_mult_fail,  py_mult_fail,    py_mult_fail, py_mult_fail },
+    { py_mult_fail,    py_mult_fail,  py_mult_fail,  py_mult_fail,    py_mult_fail, py_mult_fail },
+};
+
+extern const PY_BINOP_TABLE PY_DIV_TABLE = {
+    { py_div_int,   py_div_float, py_div_fail,  py_div_fail, py_div_fail, py_div_fail },
+    { py_div_float, py_div_float, py_div_float, py_div_fail, py_div_fail, py_div_fail },
+    { py_div_fail,  py_div_float, py_div_fail,  py_div_fail, py_div_fail, py_div_fail },
+    { py_div_fail,  py_div_fail,  py_div_fail,  py_div_fail, py_div_fail, py_div_fail },
+    { py_div_fail,  py_div_fail,  py_div_fail,  py_div_fail, py_div_fail, py_div_fail },
+    { py_div_fail,  py_div_fail,  py_div_fail,  py_div_fail, py_div_fail, py_div_fail },
+};
+
+// Shallow copy into a new, unshared list (Python's list.copy()).
+PY_OJ PY_LIST_COPY(const PY_OJ& list) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("copy can only be used on lists");
+    }
+    PY_OJ_COUNT(deep_copies);
+    return PY_OJ(new PY_LIST_OBJ(*list.list_obj()));
+}
+
+void PY_LIST_OBJ::copy_elements(const PY_LIST_OBJ& source, int64_t start, int64_t step, size_t count) {
+    auto copy = [&](auto& to, const auto& from) {
+        auto first = from.begin() + source.head + start;
+        if (step == 1) {
+            to.assign(first, first + count);
+            return;
+        }
+        to.reserve(count);
+        for (size_t i = 0; i < count; ++i) to.push_back(first[static_cast<int64_t>(i) * step]);
+    };
+    kind = source.kind;
+    switch (kind) {
+        case PY_LIST_KIND::INTS: copy(ints, source.ints); break;
+        case PY_LIST_KIND::FLOATS: copy(floats, source.floats); break;
+        default: copy(items, source.items); break;
+    }
+}
+
+// A VIEW about to be mutated copies the elements it shows.
+void PY_LIST_OBJ::materialize() {
+    PY_OJ_COUNT(deep_copies);
+    copy_elements(*view->source, view->start, view->step, view->count);
+    release_view();
+}
+
+// A list about to be mutated moves its views onto a copy of its current
+// elements that nothing else can reach, so they keep seeing those.
+void PY_LIST_OBJ::detach_views() {
+    PY_OJ_COUNT(deep_copies);
+    PY_LIST_OBJ* snapshot = new PY_LIST_OBJ(*this);
+    snapshot->refcount = 0;
+    for (PY_LIST_OBJ* other = first_view; other; other = other->view->next) {
+        other->view->source = snapshot;
+        ++snapshot->refcount;
+        --refcount;
+    }
+    snapshot->first_view = first_view;
+    first_view = nullptr;
+}
+
+void PY_LIST_OBJ::release_view() noexcept {
+    PY_LIST_VIEW* window = view;
+    PY_LIST_OBJ* source = window->source;
+    view = nullptr;
+    if (window->prev) {
+        window->prev->view->next = window->next;
+    } else {
+        source->first_view = window->next;
+    }
+    if (window->next) window->next->view->prev = window->prev;
+    delete window;
+    if (--source->refcount == 0) delete source;
+}
+
+// Slice bounds are clamped to the sequence, so bigints only need a sign.
+static int64_t py_slice_value(const PY_OJ& value) {
+    if (value.type() != PY_OJ_Type::INT) {
+        throw std::runtime_error("Slice indices must be integers");
+    }
+    if (value.is_int()) return value.int_value();
+    return value.big_value().is_negative() ? INT64_MIN : INT64_MAX;
+}
+
+struct PY_SLICE_RANGE {
+    int64_t start;
+    int64_t step;
+    size_t count;
+};
+
+// The indices obj[start:stop:step] selects from a sequence of size
+// elements, as CPython's PySlice_AdjustIndices computes them.
+static PY_SLICE_RANGE py_slice_range(size_t size, const PY_SLICE_ARG& start_arg, const PY_SLICE_ARG& stop_arg,
+                                     const PY_SLICE_ARG& step_arg) {
+    int64_t length = static_cast<int64_t>(size);
+    int64_t step = step_arg.given ? py_slice_value(step_arg.value) : 1;
+    if (step == 0) {
+        throw std::runtime_error("Slice step cannot be zero");
+    }
+    step = std::max(step, -INT64_MAX);
+    auto bound = [&](const PY_SLICE_ARG& arg, int64_t omitted) {
+        if (!arg.given) return omitted;
+        int64_t index = py_slice_value(arg.value);
+        if (index < 0) {
+            return index < -length ? (step < 0 ? int64_t(-1) : int64_t(0)) : index + length;
+        }
+        return index >= length ? (step < 0 ? length - 1 : length) : index;
+    };
+    int64_t start = bound(start_arg, step < 0 ? length - 1 : 0);
+    int64_t stop = bound(stop_arg, step < 0 ? -1 : length);
+    size_t count = 0;
+    if (step > 0 && stop > start) {
+        count = static_cast<size_t>((stop - start - 1) / step + 1);
+    } else if (step < 0 && start > stop) {
+        count = static_cast<size_t>((start - stop - 1) / -step + 1);
+    }
+    // A single element needs no stride, which keeps composed strides small
+    if (count <= 1) step = 1;
+    return {start, step, count};
+}
+
+PY_OJ PY_SLICE(const PY_OJ& obj, const PY_SLICE_ARG& start, const PY_SLICE_ARG& stop, const PY_SLICE_ARG& step) {
+    if (obj.type() == PY_OJ_Type::LIST) {
+        PY_LIST_OBJ* list = obj.list_obj();
+        PY_SLICE_RANGE range = py_slice_range(list->size(), start, stop, step);
+        // A slice of a view is a view of the same source
+        if (list->kind == PY_LIST_KIND::VIEW) {
+            range.start = list->view->start + range.start * list->view->step;
+            range.step *= list->view->step;
+            list = list->view->source;
+        }
+#ifdef PY_OJ_THREADS
+        // A view registers itself with its source, which other threads may
+        // be reading at the same time
+        bool copied = true;
+#else
+        bool copied = range.count < PY_LIST_VIEW_MIN;
+#endif
+        if (copied) {
+            PY_LIST_OBJ* copy = new PY_LIST_OBJ(std::vector<PY_OJ>());
+            copy->copy_elements(*list, range.start, range.step, range.count);
+            return PY_OJ(copy);
+        }
+        return PY_OJ(new PY_LIST_OBJ(list, range.start, range.step, range.count));
+    }
+    if (obj.type() == PY_OJ_Type::STRING) {
+        std::string_view str = obj.str_view();
+        PY_SLICE_RANGE range = py_slice_range(str.size(), start, stop, step);
+        if (range.step == 1 && range.count > PY_OJ_SSO_CAPACITY) {
+            return PY_OJ(PY_STR_OBJ::slice(obj.str_obj(), range.start, range.count));
+        }
+        std::string result;
+        result.reserve(range.count);
+        for (size_t i = 0; i < range.count; ++i) result += str[range.start + static_cast<int64_t>(i) * range.step];
+        return PY_OJ(result);
+    }
+    throw std::runtime_error("Slicing can only be used on lists and strings");
+}
+
 PY_OJ PY_LIST_DELETE(PY_OJ& list, const PY_OJ& index) {
-    if (list.active_type != PY_OJ_Type::LIST) {
+    if (list.type() != PY_OJ_Type::LIST) {
         throw std::runtime_error("Delete can only be used on lists");
     }
-    auto index_value = type_inference(index);
-    if (!std::holds_alternative<int>(index_value)) {
+    if (index.type() != PY_OJ_Type::INT) {
         throw std::runtime_error("List index must be an integer");
     }
-    int idx = std::get<int>(index_value);
-    if (idx < 0 || idx >= static_cast<int>(list.l->size())) {
+    int64_t idx = index.is_int() ? index.int_value() : -1;
+    if (idx < 0 || idx >= static_cast<int64_t>(list.list_obj()->size())) {
         throw std::runtime_error("List index out of range");
     }
-    PY_OJ removed_item = (*list.l)[idx];
-    list.l->erase(list.l->begin() + idx);
-    return removed_item; // Return the removed item, similar to Python's pop()
+    return list.list_obj()->remove(idx); // Return the removed item, similar to Python's pop()
 }
 
-PY_OJ PY_LIST_GET(const PY_OJ& list, const PY_OJ& index) {
-    if (list.active_type != PY_OJ_Type::LIST) {
-        throw std::runtime_error("Subscript can only be used on lists");
+PY_OJ PY_LIST_POP(const PY_OJ& list) {
+    return PY_LIST_POP(list, PY_OJ(-1));
+}
+
+PY_OJ PY_LIST_POP(const PY_OJ& list, const PY_OJ& index) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("pop can only be used on lists");
     }
-    auto index_value = type_inference(index);
-    if (!std::holds_alternative<int>(index_value)) {
+    if (index.type() != PY_OJ_Type::INT) {
         throw std::runtime_error("List index must be an integer");
     }
-    int idx = std::get<int>(index_value);
-    if (idx < 0 || idx >= static_cast<int>(list.l->size())) {
-        throw std::runtime_error("List index out of range");
+    PY_LIST_OBJ* obj = list.list_obj();
+    int64_t size = static_cast<int64_t>(obj->size());
+    if (size == 0) {
+        throw std::runtime_error("pop from empty list");
+    }
+    int64_t idx = index.is_int() ? index.int_value() : size;
+    if (idx < 0) idx += size;
+    if (idx < 0 || idx >= size) {
+        throw std::runtime_error("pop index out of range");
     }
-    return (*list.l)[idx];
+    return obj->remove(idx);
 }
 
-template<typename Op>
-bool PY_COMPARE(const PY_OJ& a, Op op, const PY_OJ& b) {
-    auto type_a = type_inference(a);
-    auto type_b = type_inference(b);
+PY_OJ PY_LIST_INSERT(const PY_OJ& list, const PY_OJ& index, PY_OJ item) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("insert can only be used on lists");
+    }
+    if (index.type() != PY_OJ_Type::INT) {
+        throw std::runtime_error("List index must be an integer");
+    }
+    PY_LIST_OBJ* obj = list.list_obj();
+    int64_t size = static_cast<int64_t>(obj->size());
+    // A big int index is past either end
+    int64_t idx = index.is_int() ? index.int_value() : (index < PY_OJ(0) ? -size : size);
+    if (idx < 0) idx = std::max<int64_t>(idx + size, 0);
+    obj->insert(std::min(idx, size), std::move(item));
+    return PY_OJ(); // Return None
+}
+
+// Element equality inside list comparisons. The same list object is equal
+// to itself without being walked, which also keeps a list that contains
+// itself from recursing forever.
+bool py_equal(const PY_OJ& a, const PY_OJ& b) {
+    if (a.type() == PY_OJ_Type::LIST && b.type() == PY_OJ_Type::LIST && a.list_obj() == b.list_obj()) {
+        return true;
+    }
+    return PY_COMPARE(a, std::equal_to<>(), b);
+}
 
-    return std::visit([&op](const auto& a, const auto& b) -> bool {
-        using T1 = std::decay_t<decltype(a)>;
-        using T2 = std::decay_t<decltype(b)>;
+bool py_dict_equal(const PY_DICT_OBJ* a, const PY_DICT_OBJ* b) {
+    if (a == b) return true;
+    if (a->size() != b->size()) return false;
+    for (const PY_DICT_ENTRY& entry : a->entries) {
+        ptrdiff_t found = b->find(entry.key, entry.hash);
+        if (found < 0 || !py_equal(entry.value, b->entries[found].value)) return false;
+    }
+    return true;
+}
 
-        if constexpr (std::is_same_v<T1, T2>) {
-            return op(a, b);
-        } else if constexpr (std::is_arithmetic_v<T1> && std::is_arithmetic_v<T2>) {
-            return op(static_cast<double>(a), static_cast<double>(b));
-        } else {
-            throw std::runtime_error("Incompatible types for comparison");
+// Builtins over lists: sum(), min() and max().
+PY_OJ PY_SUM(const PY_OJ& list) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("sum() expects a list");
+    }
+    PY_LIST_SPAN span = list.list_obj()->span();
+    if (span.kind == PY_LIST_KIND::INTS) {
+        int64_t total = 0;
+        bool overflow = false;
+        const int64_t* values = span.ints();
+        for (size_t i = 0; i < span.size; ++i) {
+            overflow |= __builtin_add_overflow(total, values[i], &total);
         }
-    }, type_a, type_b);
+        if (!overflow) return PY_OJ(total);
+    } else if (span.kind == PY_LIST_KIND::FLOATS) {
+        float total = 0;
+        const float* values = span.floats();
+        for (size_t i = 0; i < span.size; ++i) total += values[i];
+        return PY_OJ(total);
+    }
+    PY_OJ total(0);
+    for (size_t i = 0; i < span.size; ++i) {
+        total = PY_ADD(total, span.get(i));
+    }
+    return total;
 }
 
-bool operator<(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::less<>(), b);
+template<typename Better>
+static PY_OJ py_list_extreme(const PY_OJ& list, Better better, const char* name) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error(std::string(name) + "() expects a list");
+    }
+    PY_LIST_SPAN span = list.list_obj()->span();
+    if (span.size == 0) {
+        throw std::runtime_error(std::string(name) + "() arg is an empty sequence");
+    }
+    if (span.kind == PY_LIST_KIND::INTS) {
+        const int64_t* values = span.ints();
+        int64_t best = values[0];
+        for (size_t i = 1; i < span.size; ++i) best = better(values[i], best) ? values[i] : best;
+        return PY_OJ(best);
+    }
+    if (span.kind == PY_LIST_KIND::FLOATS) {
+        const float* values = span.floats();
+        float best = values[0];
+        for (size_t i = 1; i < span.size; ++i) best = better(values[i], best) ? values[i] : best;
+        return PY_OJ(best);
+    }
+    PY_OJ best = span.get(0);
+    for (size_t i = 1; i < span.size; ++i) {
+        span.with_item(i, [&](const PY_OJ& value) {
+            if (PY_COMPARE(value, better, best)) best = value;
+            return true;
+        });
+    }
+    return best;
 }
 
-bool operator<=(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::less_equal<>(), b);
+PY_OJ PY_MIN(const PY_OJ& list) { return py_list_extreme(list, std::less<>(), "min"); }
+PY_OJ PY_MAX(const PY_OJ& list) { return py_list_extreme(list, std::greater<>(), "max"); }
+
+size_t PY_HASH(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::LIST: return std::hash<const void*>()(obj.list_obj());
+        case PY_OJ_Type::DICT: return std::hash<const void*>()(obj.dict_obj());
+        default: return py_key_hash(obj);
+    }
 }
 
-bool operator>(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::greater<>(), b);
+bool py_same_value(const PY_OJ& a, const PY_OJ& b) {
+    if (a.type() != b.type()) return false;
+    switch (a.type()) {
+        case PY_OJ_Type::INT:
+            if (a.is_int() != b.is_int()) return false;
+            return a.is_int() ? a.int_value() == b.int_value() : a.big_value() == b.big_value();
+        case PY_OJ_Type::FLOAT: return a.float_value() == b.float_value();
+        case PY_OJ_Type::CHAR: return a.char_value() == b.char_value();
+        case PY_OJ_Type::STRING: return a.str_view() == b.str_view();
+        case PY_OJ_Type::LIST: return a.list_obj() == b.list_obj();
+        case PY_OJ_Type::DICT: return a.dict_obj() == b.dict_obj();
+    }
+    return false;
 }
 
-bool operator>=(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::greater_equal<>(), b);
+void PY_PROFILER::report() {
+    if (entries.empty()) return;
+    // Ticks are converted with the rate measured over the whole run
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+    uint64_t elapsed_ticks = py_profile_ticks() - start_ticks;
+    double ms_per_tick = elapsed_ticks ? elapsed_ms / elapsed_ticks : 0.0;
+    std::vector<const PY_PROFILE_ENTRY*> rows(entries.begin(), entries.end());
+    std::stable_sort(rows.begin(), rows.end(), [](const PY_PROFILE_ENTRY* a, const PY_PROFILE_ENTRY* b) {
+        return a->self > b->self;
+    });
+    int width = 8;
+    for (const PY_PROFILE_ENTRY* row : rows) {
+        width = std::max(width, static_cast<int>(std::strlen(row->name)));
+    }
+    py_output.flush();
+    std::fprintf(stderr, "%-*s %6s %12s %14s %14s\n", width, "function", "line", "calls", "inclusive ms", "self ms");
+    for (const PY_PROFILE_ENTRY* row : rows) {
+        if (row->calls == 0) continue;
+        std::fprintf(stderr, "%-*s %6d %12llu %14.3f %14.3f\n", width, row->name, row->line,
+                     static_cast<unsigned long long>(row->calls),
+                     row->inclusive * ms_per_tick, row->self * ms_per_tick);
+    }
 }
 
-bool operator==(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::equal_to<>(), b);
+// One "<kind> <key> <type>,<type>... <count>" line per observed tuple.
+void PY_TYPE_SITE::write(std::string& out) const {
+    for (const auto& [tuple, count] : seen) {
+        out.append(kind).append(" ").append(key).append(" ");
+        for (unsigned i = arity; i-- > 0;) {
+            out.append(TYPE_NAMES[(tuple >> (3 * i)) & 7]).append(i ? "," : "");
+        }
+        out.append(" ").append(std::to_string(count)).append("\n");
+    }
 }
 
-bool operator!=(const PY_OJ& a, const PY_OJ& b) {
-    return PY_COMPARE(a, std::not_equal_to<>(), b);
+PY_TYPE_PROFILE::~PY_TYPE_PROFILE() {
+    if (text.empty()) return;
+    const char* path = std::getenv("PY_TYPE_PROFILE");
+    if (!path) path = "py-types.profile";
+    std::FILE* out = std::fopen(path, "w");
+    if (!out) {
+        std::fprintf(stderr, "cannot write type profile %s\n", path);
+        return;
+    }
+    std::fwrite(text.data(), 1, text.size(), out);
+    std::fclose(out);
 }
 
-void PY_PRINT() {
-    std::cout << std::endl;
+PY_TYPE_SITE::~PY_TYPE_SITE() {
+    write(py_type_profile.text);
 }
 
-template<typename... Args>
-void PY_PRINT(const PY_OJ& first, const Args&... args) {
-    auto value = type_inference(first);
-    std::visit([](const auto& v) {
-        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::vector<PY_OJ>>) {
-            std::cout << "[";
-            for (size_t i = 0; i < v.size(); ++i) {
-                print_py_oj(v[i]);
-                if (i < v.size() - 1) std::cout << ", ";
-            }
-            std::cout << "]";
-        } else {
-            std::cout << v;
+#ifdef PY_OJ_THREADS
+// Work-stealing pool behind py_parallel_for. A job's chunks are dealt out
+// as one contiguous run per thread. Every thread takes chunks from the front
+// of its own run and, once that is empty, steals the back half of another
+// thread's run, so threads that drew cheap chunks take over work from the
+// others without a shared queue. Pool threads sleep between jobs; the
+// thread that submits a job works on it as well.
+struct PY_THREAD_POOL {
+    // Chunks per thread a job is cut into, for stealing to balance
+    static constexpr size_t CHUNKS_PER_THREAD = 8;
+
+    struct alignas(64) RUN {
+        std::mutex lock;
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    std::mutex submit;   // one job at a time
+    std::mutex lock;     // guards generation, running, stopping and error
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::vector<std::thread> threads;
+    std::unique_ptr<RUN[]> runs;  // one per thread, the submitter's first
+    size_t width = 1;    // threads a job runs on, the submitter included
+    uint64_t generation = 0;
+    size_t running = 0;  // pool threads not done with the current job
+    bool stopping = false;
+
+    const std::function<void(size_t, size_t)>* body = nullptr;
+    size_t count = 0;
+    size_t chunk = 0;
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+
+    PY_THREAD_POOL() {
+        size_t size = std::thread::hardware_concurrency();
+        if (const char* env = std::getenv("PY_THREADS")) size = std::strtoul(env, nullptr, 10);
+        resize(size);
+    }
+
+    ~PY_THREAD_POOL() { stop(); }
+
+    size_t size() const { return width; }
+
+    // New threads wait for the generation after the current one
+    void resize(size_t size) {
+        stop();
+        stopping = false;
+        width = std::max<size_t>(size, 1);
+        runs.reset(new RUN[width]);
+        for (size_t id = 1; id < width; ++id) {
+            threads.emplace_back([this, id, seen = generation] { serve(id, seen); });
         }
-        std::cout << " ";
-    }, value);
-    PY_PRINT(args...);
-}
-
-// Helper function to print PY_OJ values
-void print_py_oj(const PY_OJ& obj) {
-    auto value = type_inference(obj);
-    std::visit([](const auto& v) {
-        if constexpr (std::is_same_v<std::decay_t<decltype(v)>, std::vector<PY_OJ>>) {
-            std::cout << "[";
-            for (size_t i = 0; i < v.size(); ++i) {
-                print_py_oj(v[i]);
-                if (i < v.size() - 1) std::cout << ", ";
-            }
-            std::cout << "]";
-        } else {
-            std::cout << v;
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
         }
-    }, value);
-}
\ No newline at end of file
+        wake.notify_all();
+        for (std::thread& thread : threads) thread.join();
+        threads.clear();
+    }
+
+    void run(size_t job_count, const std::function<void(size_t, size_t)>& job) {
+        size_t participants = size();
+        body = &job;
+        count = job_count;
+        chunk = std::max<size_t>(1, job_count / (participants * CHUNKS_PER_THREAD));
+        size_t chunks = (job_count + chunk - 1) / chunk;
+        for (size_t id = 0; id < participants; ++id) {
+            runs[id].next = chunks * id / participants;
+            runs[id].end = chunks * (id + 1) / participants;
+        }
+        failed = false;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            error = nullptr;
+            ++generation;
+            running = threads.size();
+        }
+        wake.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [this] { return running == 0; });
+        body = nullptr;
+        if (error) std::rethrow_exception(error);
+    }
+
+    void serve(size_t id, uint64_t seen);
+    void work(size_t id);
+    bool take(size_t id, size_t& index);
+};
+
+// Set on pool threads, and on the submitting thread while it works on a
+// job: a parallel map nested in another one runs serially.
+static thread_local bool py_in_parallel = false;
+
+void PY_THREAD_POOL::serve(size_t id, uint64_t seen) {
+    py_in_parallel = true;
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake.wait(guard, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        guard.unlock();
+        work(id);
+        guard.lock();
+        if (--running == 0) done.notify_one();
+    }
+}
+
+void PY_THREAD_POOL::work(size_t id) {
+    size_t index;
+    while (take(id, index)) {
+        // After a failure the remaining chunks are only drained
+        if (failed) continue;
+        size_t begin = index * chunk;
+        try {
+            (*body)(begin, std::min(count, begin + chunk));
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!error) error = std::current_exception();
+            failed = true;
+        }
+    }
+}
+
+bool PY_THREAD_POOL::take(size_t id, size_t& index) {
+    RUN& own = runs[id];
+    {
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (own.next < own.end) {
+            index = own.next++;
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < size(); ++offset) {
+        RUN& victim = runs[(id + offset) % size()];
+        size_t begin, end;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            size_t left = victim.end - victim.next;
+            if (left == 0) continue;
+            end = victim.end;
+            begin = end - (left + 1) / 2;
+            victim.end = begin;
+        }
+        // Run the first stolen chunk now and keep the rest for later
+        index = begin;
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.next = begin + 1;
+        own.end = end;
+        return true;
+    }
+    return false;
+}
+
+static PY_THREAD_POOL& py_thread_pool() {
+    static PY_THREAD_POOL pool;
+    return pool;
+}
+
+void py_parallel_for(size_t count, const std::function<void(size_t, size_t)>& body) {
+    PY_THREAD_POOL& pool = py_thread_pool();
+    if (py_in_parallel || pool.size() == 1 || count < 2) {
+        body(0, count);
+        return;
+    }
+    std::lock_guard<std::mutex> one_job(pool.submit);
+    py_in_parallel = true;
+    try {
+        pool.run(count, body);
+    } catch (...) {
+        py_in_parallel = false;
+        throw;
+    }
+    py_in_parallel = false;
+}
+
+void py_set_threads(size_t count) {
+    PY_THREAD_POOL& pool = py_thread_pool();
+    std::lock_guard<std::mutex> one_job(pool.submit);
+    pool.resize(count);
+}
+
+size_t py_thread_count() {
+    return py_thread_pool().size();
+}
+#endif
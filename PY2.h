@@ -0,0 +1,2329 @@
+// Interface of the PY_OJ runtime. Transpiled programs include this header
+// and link PY2.cpp (or a libpy2.a built from it). It keeps only what the
+// generated code needs inline: the value layout, allocation, the INT fast
+// paths and the templates; bigint arithmetic, formatting and the other slow
+// paths are compiled once in PY2.cpp.
+#ifndef PY2_H
+#define PY2_H
+
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <string_view>
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <chrono>
+#include <new>
+#include <iterator>
+#include <type_traits>
+#include <limits>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef PY_OJ_THREADS
+#include <atomic>
+#endif
+
+// PY2.cpp and the programs linked against it share PY_OJ's representation,
+// so they must be built with the same layout and allocator flags. Every
+// configuration names a different symbol, defined only by PY2.cpp, and each
+// translation unit references its own: a mismatch is an undefined symbol at
+// link time rather than memory corruption at run time.
+#ifdef PY_OJ_TAGGED
+#define PY_CONFIG_LAYOUT tagged
+#else
+#define PY_CONFIG_LAYOUT wide
+#endif
+#if defined(PY_OJ_ALLOC_POOL)
+#define PY_CONFIG_ALLOC pool
+#elif defined(PY_OJ_ALLOC_ARENA)
+#define PY_CONFIG_ALLOC arena
+#else
+#define PY_CONFIG_ALLOC malloc
+#endif
+#ifdef PY_OJ_COUNT_ALLOCS
+#define PY_CONFIG_STATS stats
+#else
+#define PY_CONFIG_STATS nostats
+#endif
+#ifdef PY_OJ_THREADS
+#define PY_CONFIG_THREADS threads
+#else
+#define PY_CONFIG_THREADS nothreads
+#endif
+#define PY_CONFIG_SYMBOL(layout, alloc, stats, threads) py_runtime_config_##layout##_##alloc##_##stats##_##threads
+#define PY_CONFIG_NAME(layout, alloc, stats, threads) PY_CONFIG_SYMBOL(layout, alloc, stats, threads)
+#define PY_RUNTIME_CONFIG PY_CONFIG_NAME(PY_CONFIG_LAYOUT, PY_CONFIG_ALLOC, PY_CONFIG_STATS, PY_CONFIG_THREADS)
+
+extern const int PY_RUNTIME_CONFIG;
+[[gnu::used]] static const int* const py_runtime_config_check = &PY_RUNTIME_CONFIG;
+
+enum class PY_OJ_Type : unsigned char { INT, FLOAT, CHAR, STRING, LIST, DICT };
+
+// Threads, compiled in with -DPY_OJ_THREADS: PY_PARALLEL_MAP (emitted by
+// the transpiler's --parallel mode) then runs on a work-stealing thread
+// pool. Values shared between threads are only read, but reading a PY_OJ
+// copies it, so reference counts (and the hash cached in a string) become
+// atomics, and the runtime's scratch state becomes per thread. Without the
+// flag, parallel maps run serially and nothing else changes.
+#ifdef PY_OJ_THREADS
+#if defined(PY_OJ_ALLOC_POOL) || defined(PY_OJ_ALLOC_ARENA)
+#error "PY_OJ_THREADS needs the default allocator"
+#endif
+template<typename T>
+using PY_ATOMIC = std::atomic<T>;
+#define PY_THREAD_LOCAL thread_local
+#else
+template<typename T>
+using PY_ATOMIC = T;
+#define PY_THREAD_LOCAL
+#endif
+
+// Allocation accounting, compiled in with -DPY_OJ_COUNT_ALLOCS. Counts heap
+// payloads created, deep copies of STRING/LIST payloads and moves, and prints
+// the totals to stderr when the program exits.
+#ifdef PY_OJ_COUNT_ALLOCS
+struct PY_OJ_ALLOC_STATS {
+    PY_ATOMIC<size_t> allocations{0};
+    PY_ATOMIC<size_t> deep_copies{0};
+    PY_ATOMIC<size_t> moves{0};
+
+    ~PY_OJ_ALLOC_STATS();
+};
+inline PY_OJ_ALLOC_STATS py_alloc_stats;
+#define PY_OJ_COUNT(counter) (++py_alloc_stats.counter)
+#else
+#define PY_OJ_COUNT(counter) ((void)0)
+#endif
+
+// Arbitrary-precision integer backing PY_OJ_Type::INT once a value leaves
+// the machine-width range. Sign and magnitude, with the magnitude stored as
+// little-endian base-2^32 limbs and no leading zero limbs (zero is empty).
+class PY_BIGINT {
+public:
+    using Limbs = std::vector<uint32_t>;
+
+    PY_BIGINT() = default;
+
+    PY_BIGINT(int64_t val) : negative(val < 0) {
+        // Negate in unsigned arithmetic so INT64_MIN is handled too
+        uint64_t mag = negative ? 0 - static_cast<uint64_t>(val) : static_cast<uint64_t>(val);
+        while (mag) {
+            limbs.push_back(static_cast<uint32_t>(mag));
+            mag >>= 32;
+        }
+    }
+
+    // Parses an optionally signed decimal literal.
+    explicit PY_BIGINT(std::string_view digits);
+
+    bool is_negative() const { return negative; }
+    bool is_zero() const { return limbs.empty(); }
+    const Limbs& magnitude() const { return limbs; }
+
+    bool fits_int64() const {
+        if (limbs.size() > 2) return false;
+        uint64_t mag = magnitude_u64();
+        return negative ? mag <= (uint64_t(1) << 63) : mag < (uint64_t(1) << 63);
+    }
+
+    int64_t to_int64() const {
+        uint64_t mag = magnitude_u64();
+        return negative ? static_cast<int64_t>(0 - mag) : static_cast<int64_t>(mag);
+    }
+
+    double to_double() const {
+        double result = 0;
+        for (size_t i = limbs.size(); i-- > 0;) {
+            result = result * 4294967296.0 + limbs[i];
+        }
+        return negative ? -result : result;
+    }
+
+    std::string to_string() const;
+    size_t hash() const;
+    PY_BIGINT operator-() const;
+    friend PY_BIGINT operator+(const PY_BIGINT& a, const PY_BIGINT& b);
+    friend PY_BIGINT operator-(const PY_BIGINT& a, const PY_BIGINT& b);
+    friend PY_BIGINT operator*(const PY_BIGINT& a, const PY_BIGINT& b);
+
+    // Three-way comparison: negative, zero or positive.
+    friend int compare(const PY_BIGINT& a, const PY_BIGINT& b);
+
+    friend bool operator==(const PY_BIGINT& a, const PY_BIGINT& b);
+
+private:
+    // Operand size (in limbs) above which multiplication switches from the
+    // schoolbook method to Karatsuba.
+    static constexpr size_t KARATSUBA_THRESHOLD = 32;
+
+    bool negative = false;
+    Limbs limbs;
+
+    PY_BIGINT(bool neg, Limbs mag) : negative(neg), limbs(std::move(mag)) {
+        trim(limbs);
+        if (limbs.empty()) negative = false;
+    }
+
+    uint64_t magnitude_u64() const {
+        uint64_t mag = 0;
+        if (limbs.size() > 0) mag |= limbs[0];
+        if (limbs.size() > 1) mag |= static_cast<uint64_t>(limbs[1]) << 32;
+        return mag;
+    }
+
+    static void trim(Limbs& mag);
+    static int compare_mag(const Limbs& a, const Limbs& b);
+    static void mul_small(Limbs& mag, uint32_t factor);
+    static void add_small(Limbs& mag, uint32_t addend);
+
+    // Divides mag in place and returns the remainder.
+    static uint32_t divmod_small(Limbs& mag, uint32_t divisor);
+
+    static Limbs add_mag(const Limbs& a, const Limbs& b);
+
+    // Requires |a| >= |b|.
+    static Limbs sub_mag(const Limbs& a, const Limbs& b);
+
+    // Adds src, shifted left by offset limbs, into dst (which must be large enough).
+    static void add_shifted(Limbs& dst, const Limbs& src, size_t offset);
+
+    static Limbs mul_schoolbook(const Limbs& a, const Limbs& b);
+
+    // Karatsuba: with a = a1*B^m + a0 and b = b1*B^m + b0,
+    // a*b = z2*B^2m + (z1 - z2 - z0)*B^m + z0 where z0 = a0*b0, z2 = a1*b1
+    // and z1 = (a0 + a1)(b0 + b1): three half-size products instead of four.
+    static Limbs mul_mag(const Limbs& a, const Limbs& b);
+};
+
+// Heap payload allocator. STRING, LIST and bigint payloads, and the element
+// arrays of lists, are allocated through py_alloc()/py_free(). The backend
+// is chosen at compile time:
+//
+// - Default: the global operator new/delete (malloc).
+// - -DPY_OJ_ALLOC_POOL: free lists for 16-byte size classes up to
+//   PY_ALLOC_SMALL_MAX bytes, carved out of PY_ALLOC_CHUNK chunks. Freed
+//   blocks are reused for the next payload of the same class and never
+//   returned to the system.
+// - -DPY_OJ_ALLOC_ARENA: a bump arena with one frame per transpiled call
+//   (PY_CALL_FRAME). Freeing the most recent block pops it; a frame whose
+//   blocks are all dead when it returns rewinds the arena to where the frame
+//   started. Blocks that outlive their frame (return values, items appended
+//   to a caller's list) are handed to the calling frame. Garbage that is not
+//   freed in LIFO order is only reclaimed when its frame returns, so a long
+//   loop in one function holds on to it until then.
+//
+// Blocks larger than PY_ALLOC_SMALL_MAX always come from operator new.
+#if defined(PY_OJ_ALLOC_POOL) && defined(PY_OJ_ALLOC_ARENA)
+#error "PY_OJ_ALLOC_POOL and PY_OJ_ALLOC_ARENA are mutually exclusive"
+#endif
+
+constexpr size_t PY_ALLOC_CHUNK = 64 * 1024;
+constexpr size_t PY_ALLOC_SMALL_MAX = 256;
+
+// Size class of a small block: blocks are rounded up to multiples of 16.
+inline size_t py_alloc_class(size_t size) {
+    return size ? (size - 1) / 16 : 0;
+}
+
+#if defined(PY_OJ_ALLOC_POOL)
+struct PY_POOL {
+    struct FREE_BLOCK {
+        FREE_BLOCK* next;
+    };
+
+    FREE_BLOCK* free_lists[PY_ALLOC_SMALL_MAX / 16] = {};
+    char* chunk = nullptr;
+    size_t chunk_left = 0;
+
+    void* allocate(size_t size) {
+        if (size > PY_ALLOC_SMALL_MAX) return ::operator new(size);
+        size_t cls = py_alloc_class(size);
+        if (FREE_BLOCK* block = free_lists[cls]) {
+            free_lists[cls] = block->next;
+            return block;
+        }
+        size_t block_size = (cls + 1) * 16;
+        if (chunk_left < block_size) {
+            chunk = static_cast<char*>(::operator new(PY_ALLOC_CHUNK));
+            chunk_left = PY_ALLOC_CHUNK;
+        }
+        void* block = chunk;
+        chunk += block_size;
+        chunk_left -= block_size;
+        return block;
+    }
+
+    void deallocate(void* block, size_t size) noexcept {
+        if (size > PY_ALLOC_SMALL_MAX) {
+            ::operator delete(block);
+            return;
+        }
+        size_t cls = py_alloc_class(size);
+        free_lists[cls] = new (block) FREE_BLOCK{free_lists[cls]};
+    }
+};
+
+inline PY_POOL py_allocator;
+#elif defined(PY_OJ_ALLOC_ARENA)
+struct PY_ARENA {
+    // A call frame remembers where the arena stood when it was entered and
+    // how many of the blocks allocated since are still alive. Every block
+    // starts with a PREFIX_SIZE prefix holding the serial of the frame that
+    // allocated it; once that frame has returned, the block belongs to the
+    // innermost live frame with a smaller serial, which is the frame the
+    // block was handed to.
+    struct FRAME {
+        uint64_t serial;
+        size_t chunk;
+        size_t offset;
+        size_t live;
+    };
+    static constexpr size_t PREFIX_SIZE = 16;
+
+    std::vector<char*> chunks;
+    size_t chunk = 0;
+    size_t offset = 0;
+    std::vector<FRAME> frames;
+    uint64_t next_serial = 1;
+
+    PY_ARENA() { chunks.push_back(static_cast<char*>(::operator new(PY_ALLOC_CHUNK))); }
+
+    // Serial of the innermost frame; 0 outside any frame.
+    uint64_t current_serial() const { return frames.empty() ? 0 : frames.back().serial; }
+
+    void* allocate(size_t size) {
+        if (size > PY_ALLOC_SMALL_MAX) return ::operator new(size);
+        size_t block_size = PREFIX_SIZE + (py_alloc_class(size) + 1) * 16;
+        if (offset + block_size > PY_ALLOC_CHUNK) {
+            if (++chunk == chunks.size()) {
+                chunks.push_back(static_cast<char*>(::operator new(PY_ALLOC_CHUNK)));
+            }
+            offset = 0;
+        }
+        char* block = chunks[chunk] + offset;
+        offset += block_size;
+        *reinterpret_cast<uint64_t*>(block) = current_serial();
+        if (!frames.empty()) ++frames.back().live;
+        return block + PREFIX_SIZE;
+    }
+
+    void deallocate(void* payload, size_t size) noexcept {
+        if (size > PY_ALLOC_SMALL_MAX) {
+            ::operator delete(payload);
+            return;
+        }
+        char* block = static_cast<char*>(payload) - PREFIX_SIZE;
+        uint64_t serial = *reinterpret_cast<uint64_t*>(block);
+        // Blocks allocated outside any frame have no owner to account to
+        for (size_t i = frames.size(); i-- > 0;) {
+            if (frames[i].serial <= serial) {
+                --frames[i].live;
+                break;
+            }
+        }
+        // The last block of the innermost frame is popped right away
+        size_t block_size = PREFIX_SIZE + (py_alloc_class(size) + 1) * 16;
+        if (serial >= current_serial() && block + block_size == chunks[chunk] + offset) {
+            offset -= block_size;
+        }
+    }
+
+    void enter() {
+        frames.push_back({next_serial++, chunk, offset, 0});
+    }
+
+    void leave() noexcept {
+        FRAME frame = frames.back();
+        frames.pop_back();
+        if (frame.live == 0) {
+            chunk = frame.chunk;
+            offset = frame.offset;
+        } else if (!frames.empty()) {
+            frames.back().live += frame.live;
+        }
+    }
+};
+
+// Chunks are not released at exit: static PY_OJ constants may still be
+// destroyed after the arena.
+inline PY_ARENA py_allocator;
+
+struct PY_ARENA_FRAME {
+    PY_ARENA_FRAME() { py_allocator.enter(); }
+    ~PY_ARENA_FRAME() { py_allocator.leave(); }
+    PY_ARENA_FRAME(const PY_ARENA_FRAME&) = delete;
+    PY_ARENA_FRAME& operator=(const PY_ARENA_FRAME&) = delete;
+};
+#endif
+
+inline void* py_alloc(size_t size) {
+#if defined(PY_OJ_ALLOC_POOL) || defined(PY_OJ_ALLOC_ARENA)
+    return py_allocator.allocate(size);
+#else
+    return ::operator new(size);
+#endif
+}
+
+inline void py_free(void* block, size_t size) noexcept {
+#if defined(PY_OJ_ALLOC_POOL) || defined(PY_OJ_ALLOC_ARENA)
+    py_allocator.deallocate(block, size);
+#else
+    (void)size;
+    ::operator delete(block);
+#endif
+}
+
+// Opens an arena frame for the rest of the enclosing scope. Transpiled
+// functions start with one; it does nothing unless -DPY_OJ_ALLOC_ARENA.
+#ifdef PY_OJ_ALLOC_ARENA
+#define PY_CALL_FRAME() PY_ARENA_FRAME py_frame
+#else
+#define PY_CALL_FRAME() ((void)0)
+#endif
+
+// std::allocator replacement that routes container storage through py_alloc.
+template<typename T>
+struct PY_ALLOCATOR {
+    using value_type = T;
+
+    PY_ALLOCATOR() = default;
+    template<typename U>
+    PY_ALLOCATOR(const PY_ALLOCATOR<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(py_alloc(n * sizeof(T))); }
+    void deallocate(T* block, size_t n) noexcept { py_free(block, n * sizeof(T)); }
+
+    friend bool operator==(const PY_ALLOCATOR&, const PY_ALLOCATOR&) { return true; }
+    friend bool operator!=(const PY_ALLOCATOR&, const PY_ALLOCATOR&) { return false; }
+};
+
+// Element storage of list payloads. With the default allocator this is
+// plain std::vector, so vectors built by generated code are moved in as is.
+#if defined(PY_OJ_ALLOC_POOL) || defined(PY_OJ_ALLOC_ARENA)
+template<typename T>
+using PY_VECTOR = std::vector<T, PY_ALLOCATOR<T>>;
+#else
+template<typename T>
+using PY_VECTOR = std::vector<T>;
+#endif
+
+template<typename T>
+inline PY_VECTOR<T> py_vector(std::vector<T>&& values) {
+    if constexpr (std::is_same_v<PY_VECTOR<T>, std::vector<T>>) {
+        return std::move(values);
+    } else {
+        return PY_VECTOR<T>(std::make_move_iterator(values.begin()), std::make_move_iterator(values.end()));
+    }
+}
+
+// STRING and LIST payloads live in reference-counted heap objects, matching
+// Python's reference semantics: copying a PY_OJ shares the payload, so
+// passing or returning a list is O(1) and mutations through one name are
+// visible through every alias. Strings are immutable and need no copy on
+// write; PY_LIST_COPY makes an independent list where a value copy is wanted.
+// Reference cycles (a list appended to itself) are not collected. Ints that
+// outgrow the machine-width fast path are promoted to a heap PY_BIGINT.
+//
+// Aligned to 8 so the tagged layout can keep its tag in the low pointer bits.
+// Payloads are allocated through py_alloc; deletes pass the payload size on.
+struct alignas(8) PY_OBJ_HEAD {
+    PY_ATOMIC<uint32_t> refcount{1};
+
+    static void* operator new(size_t size) { return py_alloc(size); }
+    static void operator delete(void* block, size_t size) noexcept { py_free(block, size); }
+};
+
+struct PY_STR_OBJ;
+struct PY_LIST_OBJ;
+struct PY_DICT_OBJ;
+struct PY_BIGINT_OBJ;
+
+// Two value layouts are available, chosen at compile time:
+//
+// - Default: a union plus a separate PY_OJ_Type byte (16 bytes). Strings of
+//   up to PY_OJ_SSO_CAPACITY bytes are stored inline in the union
+//   (small-string optimization); longer ones live behind s and are marked by
+//   sso_len == PY_OJ_ON_HEAP. Ints are int64_t; a bigint is an INT with
+//   sso_len == PY_OJ_ON_HEAP and its value behind big.
+// - -DPY_OJ_TAGGED: a single tagged 64-bit word (8 bytes). The low three
+//   bits hold the tag, ints are 61-bit values shifted above the tag,
+//   floats/chars sit in the upper 32 bits and heap payloads are stored as
+//   8-byte aligned pointers. Strings of up to 7 bytes are packed into the
+//   word itself.
+//
+// Runtime code reads values through type(), is_int(), int_value(),
+// big_value(), float_value(), char_value(), str_view(), list_obj() and
+// dict_obj() so it
+// works with either layout. is_int() is true only for machine-width ints;
+// bigints report PY_OJ_Type::INT from type() but is_big_int() instead.
+#ifdef PY_OJ_TAGGED
+constexpr unsigned char PY_OJ_SSO_CAPACITY = 7;
+#else
+constexpr unsigned char PY_OJ_SSO_CAPACITY = sizeof(void*);
+constexpr unsigned char PY_OJ_ON_HEAP = 0xFF;
+#endif
+
+struct PY_OJ {
+#ifdef PY_OJ_TAGGED
+    enum : uint64_t {
+        TAG_INT = 0, TAG_FLOAT = 1, TAG_CHAR = 2, TAG_STRING = 3, TAG_LIST = 4, TAG_SSO = 5,
+        TAG_BIGINT = 6, TAG_DICT = 7, TAG_MASK = 7
+    };
+    // Range of ints stored directly in the word; anything wider is a bigint
+    static constexpr int64_t SMALL_INT_MAX = (int64_t(1) << 60) - 1;
+    static constexpr int64_t SMALL_INT_MIN = -(int64_t(1) << 60);
+    uint64_t bits;
+
+    PY_OJ() : bits(TAG_INT) {}
+    PY_OJ(int val) : bits(static_cast<uint64_t>(static_cast<int64_t>(val)) << 3) {}
+    PY_OJ(float val) : bits(immediate(float_bits(val), TAG_FLOAT)) {}
+    PY_OJ(char val) : bits(immediate(static_cast<unsigned char>(val), TAG_CHAR)) {}
+#else
+    union {
+        int64_t i;
+        float f;
+        char c;
+        PY_STR_OBJ* s;
+        PY_LIST_OBJ* l;
+        PY_DICT_OBJ* d;
+        PY_BIGINT_OBJ* big;
+        char sso[PY_OJ_SSO_CAPACITY];
+    };
+    PY_OJ_Type active_type;
+    unsigned char sso_len = 0;
+
+    PY_OJ() : i(0), active_type(PY_OJ_Type::INT) {}
+    PY_OJ(int val) : i(val), active_type(PY_OJ_Type::INT) {}
+    PY_OJ(float val) : f(val), active_type(PY_OJ_Type::FLOAT) {}
+    PY_OJ(char val) : c(val), active_type(PY_OJ_Type::CHAR) {}
+#endif
+    PY_OJ(int64_t val) { init_int(val); }
+    PY_OJ(const PY_BIGINT& val);
+    PY_OJ(const char* val) { init_string(val, std::strlen(val)); }
+    PY_OJ(const std::string& val) { init_string(val.data(), val.size()); }
+    PY_OJ(const std::vector<PY_OJ>& val);
+    PY_OJ(std::vector<PY_OJ>&& val);
+    PY_OJ(std::vector<int64_t> val);
+    PY_OJ(std::vector<float> val);
+    // Takes ownership of a newly created list, dict or heap string payload.
+    explicit PY_OJ(PY_LIST_OBJ* list) { init_list(list); }
+    explicit PY_OJ(PY_DICT_OBJ* dict) { init_dict(dict); }
+    explicit PY_OJ(PY_STR_OBJ* str) { init_heap_string(str); }
+
+    ~PY_OJ() { release(); }
+
+    PY_OJ(const PY_OJ& other) {
+        copy_payload(other);
+    }
+
+    // Moves only transfer the payload pointer or inline bytes, so they cannot
+    // throw and std::vector<PY_OJ> relocates elements by move when it grows.
+    PY_OJ(PY_OJ&& other) noexcept {
+        steal_payload(other);
+    }
+
+    // Copy into a temporary first so that assigning from a value we own
+    // (e.g. x = x[0]) does not read freed memory.
+    PY_OJ& operator=(const PY_OJ& other) {
+        if (this != &other) {
+            PY_OJ copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    PY_OJ& operator=(PY_OJ&& other) noexcept {
+        if (this != &other) {
+            release();
+            steal_payload(other);
+        }
+        return *this;
+    }
+
+#ifdef PY_OJ_TAGGED
+    PY_OJ_Type type() const {
+        static constexpr PY_OJ_Type types[8] = {
+            PY_OJ_Type::INT, PY_OJ_Type::FLOAT, PY_OJ_Type::CHAR, PY_OJ_Type::STRING,
+            PY_OJ_Type::LIST, PY_OJ_Type::STRING, PY_OJ_Type::INT, PY_OJ_Type::DICT
+        };
+        return types[bits & TAG_MASK];
+    }
+    bool is_int() const { return (bits & TAG_MASK) == TAG_INT; }
+    bool is_big_int() const { return (bits & TAG_MASK) == TAG_BIGINT; }
+    int64_t int_value() const { return static_cast<int64_t>(bits) >> 3; }
+    float float_value() const {
+        uint32_t raw = static_cast<uint32_t>(bits >> 32);
+        float val;
+        std::memcpy(&val, &raw, sizeof(val));
+        return val;
+    }
+    char char_value() const { return static_cast<char>(bits >> 32); }
+    PY_LIST_OBJ* list_obj() const { return reinterpret_cast<PY_LIST_OBJ*>(bits & ~uint64_t(TAG_MASK)); }
+    PY_DICT_OBJ* dict_obj() const { return reinterpret_cast<PY_DICT_OBJ*>(bits & ~uint64_t(TAG_MASK)); }
+    PY_STR_OBJ* str_obj() const { return reinterpret_cast<PY_STR_OBJ*>(bits & ~uint64_t(TAG_MASK)); }
+    bool is_heap_string() const { return (bits & TAG_MASK) == TAG_STRING; }
+#else
+    PY_OJ_Type type() const { return active_type; }
+    bool is_int() const { return active_type == PY_OJ_Type::INT && sso_len != PY_OJ_ON_HEAP; }
+    bool is_big_int() const { return active_type == PY_OJ_Type::INT && sso_len == PY_OJ_ON_HEAP; }
+    int64_t int_value() const { return i; }
+    float float_value() const { return f; }
+    char char_value() const { return c; }
+    PY_LIST_OBJ* list_obj() const { return l; }
+    PY_DICT_OBJ* dict_obj() const { return d; }
+    PY_STR_OBJ* str_obj() const { return s; }
+    bool is_heap_string() const { return sso_len == PY_OJ_ON_HEAP; }
+#endif
+
+    // Read-only view of a STRING payload, wherever it is stored.
+    std::string_view str_view() const;
+
+    // Value of a bigint INT (only valid when is_big_int()).
+    const PY_BIGINT& big_value() const;
+
+    // If this is a heap string that no other value references, appends
+    // extra to it in place and returns true. Otherwise returns false and
+    // leaves the value as it is.
+    bool append_in_place(std::string_view extra);
+
+private:
+    void init_int(int64_t val);
+    void init_big(const PY_BIGINT& val);
+    void init_string(const char* data, size_t size);
+    void init_heap_string(PY_STR_OBJ* str);
+    void init_list(PY_LIST_OBJ* list);
+    void init_dict(PY_DICT_OBJ* dict);
+    void copy_payload(const PY_OJ& other);
+    void release() noexcept;
+    PY_OBJ_HEAD* heap_payload() const;
+
+#ifdef PY_OJ_TAGGED
+    static uint64_t immediate(uint32_t payload, uint64_t tag) {
+        return (static_cast<uint64_t>(payload) << 32) | tag;
+    }
+
+    static uint32_t float_bits(float val) {
+        uint32_t raw;
+        std::memcpy(&raw, &val, sizeof(raw));
+        return raw;
+    }
+
+    // Takes over other's payload and leaves it holding the int 0.
+    void steal_payload(PY_OJ& other) noexcept {
+        bits = other.bits;
+        other.bits = TAG_INT;
+        PY_OJ_COUNT(moves);
+    }
+#else
+    // Takes over other's payload and leaves it holding the int 0.
+    void steal_payload(PY_OJ& other) noexcept {
+        std::memcpy(sso, other.sso, PY_OJ_SSO_CAPACITY);
+        active_type = other.active_type;
+        sso_len = other.sso_len;
+        other.i = 0;
+        other.active_type = PY_OJ_Type::INT;
+        other.sso_len = 0;
+        PY_OJ_COUNT(moves);
+    }
+#endif
+};
+
+#ifdef PY_OJ_TAGGED
+static_assert(sizeof(PY_OJ) == 8, "tagged PY_OJ must fit in one word");
+#endif
+
+// The bytes of a heap string follow the header in the same block instead
+// of living in a separately allocated std::string. A slice of a heap
+// string (s[a:b]) does not copy: its header points into the bytes of the
+// original, which it keeps alive through owner.
+//
+// Strings are immutable as far as Python code can tell, but a string that
+// only one value references can be extended in place (see
+// PY_OJ::append_in_place): the block then has room for capacity bytes and
+// grows geometrically, like a std::string, so s = s + x in a loop is linear.
+struct PY_STR_OBJ : PY_OBJ_HEAD {
+    size_t size = 0;
+    size_t capacity = 0;            // bytes after the header; 0 for slices
+    // py_key_hash() of the bytes, computed on first use (0 = not yet)
+    mutable PY_ATOMIC<size_t> hash{0};
+    const char* data = nullptr;     // this + 1, or inside owner
+    PY_STR_OBJ* owner = nullptr;    // slices: the string data points into
+
+    std::string_view view() const { return std::string_view(data, size); }
+
+    // size bytes copied from bytes, in a block with room for capacity.
+    static PY_STR_OBJ* create(const char* bytes, size_t size, size_t capacity) {
+        PY_STR_OBJ* obj = ::new (py_alloc(sizeof(PY_STR_OBJ) + capacity)) PY_STR_OBJ;
+        obj->size = size;
+        obj->capacity = capacity;
+        obj->data = reinterpret_cast<const char*>(obj + 1);
+        std::memcpy(obj->bytes(), bytes, size);
+        return obj;
+    }
+
+    static PY_STR_OBJ* create(const char* bytes, size_t size) { return create(bytes, size, size); }
+
+    // Writable bytes of a string that is not a slice.
+    char* bytes() { return reinterpret_cast<char*>(this + 1); }
+
+    // Appends extra to obj, an unshared non-slice, and returns the string:
+    // obj itself if it had room, otherwise a copy with twice the capacity
+    // (obj is freed). extra may point into obj.
+    static PY_STR_OBJ* append(PY_STR_OBJ* obj, std::string_view extra) {
+        size_t size = obj->size + extra.size();
+        obj->hash = 0;
+        if (size <= obj->capacity) {
+            std::memcpy(obj->bytes() + obj->size, extra.data(), extra.size());
+            obj->size = size;
+            return obj;
+        }
+        PY_STR_OBJ* grown = create(obj->data, obj->size, std::max(size, 2 * obj->capacity));
+        std::memcpy(grown->bytes() + obj->size, extra.data(), extra.size());
+        grown->size = size;
+        destroy(obj);
+        return grown;
+    }
+
+    // size bytes of source starting at start, sharing source's storage.
+    static PY_STR_OBJ* slice(PY_STR_OBJ* source, size_t start, size_t size) {
+        PY_STR_OBJ* owner = source->owner ? source->owner : source;
+        PY_STR_OBJ* obj = ::new (py_alloc(sizeof(PY_STR_OBJ))) PY_STR_OBJ;
+        obj->size = size;
+        obj->data = source->data + start;
+        obj->owner = owner;
+        ++owner->refcount;
+        return obj;
+    }
+
+    static void destroy(PY_STR_OBJ* obj) noexcept {
+        PY_STR_OBJ* owner = obj->owner;
+        if (owner == nullptr) {
+            py_free(obj, sizeof(PY_STR_OBJ) + obj->capacity);
+            return;
+        }
+        py_free(obj, sizeof(PY_STR_OBJ));
+        if (--owner->refcount == 0) destroy(owner);
+    }
+};
+
+// Element storage of a list. A list whose elements are all machine-width
+// ints, or all floats, keeps them unboxed in one contiguous array (8 or 4
+// bytes per element, no tags). Appending any other element converts the list
+// to BOXED storage, which holds full PY_OJ values, for the rest of its life.
+//
+// A slice (lst[a:b:c]) is a VIEW: it reads the elements of the sliced list
+// in place instead of copying them. Python slices are independent lists, so
+// whichever side is mutated first copies: a VIEW copies its elements into
+// storage of its own, and a list with live views first moves the views onto
+// a private copy of its current elements (see unshare()).
+enum class PY_LIST_KIND : unsigned char { BOXED, INTS, FLOATS, VIEW };
+
+struct PY_LIST_OBJ;
+struct PY_LIST_SPAN;
+
+// Window of a VIEW list onto its source.
+struct PY_LIST_VIEW {
+    PY_LIST_OBJ* source;   // holds a reference; never a VIEW itself
+    int64_t start;
+    int64_t step;
+    size_t count;
+    // Siblings in the chain of views of source
+    PY_LIST_OBJ* prev;
+    PY_LIST_OBJ* next;
+
+    static void* operator new(size_t size) { return py_alloc(size); }
+    static void operator delete(void* block, size_t size) noexcept { py_free(block, size); }
+};
+
+struct PY_LIST_OBJ : PY_OBJ_HEAD {
+    PY_LIST_KIND kind = PY_LIST_KIND::BOXED;
+    PY_VECTOR<PY_OJ> items;   // BOXED
+    PY_VECTOR<int64_t> ints;  // INTS
+    PY_VECTOR<float> floats;  // FLOATS
+    // Leading slots of the storage above that are no longer elements, so
+    // popping the front is O(1); the elements are storage[head:]
+    size_t head = 0;
+    PY_LIST_VIEW* view = nullptr;        // VIEW
+    PY_LIST_OBJ* first_view = nullptr;   // live VIEWs of this list
+
+    explicit PY_LIST_OBJ(std::vector<PY_OJ> values) {
+        kind = storage_for(values);
+        if (kind == PY_LIST_KIND::INTS) {
+            ints.reserve(values.size());
+            for (const PY_OJ& value : values) ints.push_back(value.int_value());
+        } else if (kind == PY_LIST_KIND::FLOATS) {
+            floats.reserve(values.size());
+            for (const PY_OJ& value : values) floats.push_back(value.float_value());
+        } else {
+            items = py_vector(std::move(values));
+        }
+    }
+    explicit PY_LIST_OBJ(std::vector<int64_t> values) : kind(PY_LIST_KIND::INTS), ints(py_vector(std::move(values))) {}
+    explicit PY_LIST_OBJ(std::vector<float> values) : kind(PY_LIST_KIND::FLOATS), floats(py_vector(std::move(values))) {}
+
+    // count elements of source from start by step. The new VIEW takes a
+    // reference to source.
+    PY_LIST_OBJ(PY_LIST_OBJ* source, int64_t start, int64_t step, size_t count)
+        : kind(PY_LIST_KIND::VIEW), view(new PY_LIST_VIEW{source, start, step, count, nullptr, source->first_view}) {
+        ++source->refcount;
+        if (source->first_view) source->first_view->view->prev = this;
+        source->first_view = this;
+    }
+
+    // Shallow copy with the same storage (a VIEW's copy gets its own); the
+    // copy starts unshared.
+    PY_LIST_OBJ(const PY_LIST_OBJ& other) : PY_OBJ_HEAD() {
+        if (other.kind == PY_LIST_KIND::VIEW) {
+            copy_elements(*other.view->source, other.view->start, other.view->step, other.view->count);
+        } else {
+            copy_elements(other, 0, 1, other.size());
+        }
+    }
+
+    PY_LIST_OBJ& operator=(const PY_LIST_OBJ&) = delete;
+
+    ~PY_LIST_OBJ() {
+        if (view) release_view();
+    }
+
+    size_t size() const {
+        switch (kind) {
+            case PY_LIST_KIND::INTS: return ints.size() - head;
+            case PY_LIST_KIND::FLOATS: return floats.size() - head;
+            case PY_LIST_KIND::VIEW: return view->count;
+            default: return items.size() - head;
+        }
+    }
+
+    // The elements as one run of storage; see PY_LIST_SPAN.
+    PY_LIST_SPAN span() const;
+
+    PY_OJ get(size_t index) const {
+        switch (kind) {
+            case PY_LIST_KIND::INTS: return PY_OJ(ints[head + index]);
+            case PY_LIST_KIND::FLOATS: return PY_OJ(floats[head + index]);
+            case PY_LIST_KIND::VIEW: return view->source->get(view->start + static_cast<int64_t>(index) * view->step);
+            default: return items[head + index];
+        }
+    }
+
+    // Gives this list storage of its own and no views before it is
+    // mutated; every mutating member calls it first.
+    void unshare() {
+        if (kind == PY_LIST_KIND::VIEW) materialize();
+        if (first_view) detach_views();
+    }
+
+    void set(size_t index, PY_OJ item) {
+        unshare();
+        if (kind == PY_LIST_KIND::INTS && item.is_int()) {
+            ints[head + index] = item.int_value();
+        } else if (kind == PY_LIST_KIND::FLOATS && item.type() == PY_OJ_Type::FLOAT) {
+            floats[head + index] = item.float_value();
+        } else {
+            PY_VECTOR<PY_OJ>& values = boxed();
+            values[head + index] = std::move(item);
+        }
+    }
+
+    void append(PY_OJ item) {
+        unshare();
+        // An empty list has no elements to keep, so it takes the storage of
+        // its first element instead of staying BOXED
+        if (size() == 0) {
+            items.clear();
+            head = 0;
+            kind = storage_for_item(item);
+        }
+        if (kind == PY_LIST_KIND::INTS && item.is_int()) {
+            ints.push_back(item.int_value());
+        } else if (kind == PY_LIST_KIND::FLOATS && item.type() == PY_OJ_Type::FLOAT) {
+            floats.push_back(item.float_value());
+        } else {
+            boxed().push_back(std::move(item));
+        }
+    }
+
+    // Inserts item before element index (index <= size()).
+    void insert(size_t index, PY_OJ item) {
+        unshare();
+        if (index == size()) {
+            append(std::move(item));
+        } else if (kind == PY_LIST_KIND::INTS && item.is_int()) {
+            insert_at(ints, index, item.int_value());
+        } else if (kind == PY_LIST_KIND::FLOATS && item.type() == PY_OJ_Type::FLOAT) {
+            insert_at(floats, index, item.float_value());
+        } else {
+            PY_VECTOR<PY_OJ>& values = boxed();
+            insert_at(values, index, std::move(item));
+        }
+    }
+
+    // Removes element index and returns it; the element is moved out, not
+    // copied. Amortized O(1) at either end.
+    PY_OJ remove(size_t index) {
+        unshare();
+        switch (kind) {
+            case PY_LIST_KIND::INTS: {
+                PY_OJ removed(ints[head + index]);
+                erase_at(ints, index);
+                return removed;
+            }
+            case PY_LIST_KIND::FLOATS: {
+                PY_OJ removed(floats[head + index]);
+                erase_at(floats, index);
+                return removed;
+            }
+            default: {
+                PY_OJ removed = std::move(items[head + index]);
+                erase_at(items, index);
+                return removed;
+            }
+        }
+    }
+
+    // Converts to BOXED storage (if needed) and returns the boxed elements.
+    PY_VECTOR<PY_OJ>& boxed() {
+        unshare();
+        if (kind != PY_LIST_KIND::BOXED) {
+            items = py_vector(to_vector());
+            ints = {};
+            floats = {};
+            head = 0;
+            kind = PY_LIST_KIND::BOXED;
+        }
+        return items;
+    }
+
+    // Boxed copy of the elements, leaving the storage as it is.
+    std::vector<PY_OJ> to_vector() const {
+        if (kind == PY_LIST_KIND::BOXED) return std::vector<PY_OJ>(items.begin() + head, items.end());
+        std::vector<PY_OJ> values;
+        values.reserve(size());
+        for (size_t i = 0; i < size(); ++i) values.push_back(get(i));
+        return values;
+    }
+
+    // Fills this (empty) list with count elements of source, a non-VIEW,
+    // from start by step, in source's storage kind.
+    void copy_elements(const PY_LIST_OBJ& source, int64_t start, int64_t step, size_t count);
+
+private:
+    void materialize();
+    void detach_views();
+    void release_view() noexcept;
+
+    // Lists shorter than this insert at the front by shifting; see insert_at
+    static constexpr size_t FRONT_GAP_MIN = 16;
+
+    // Front insertion reuses a dead slot before head. Without one, a list
+    // of at least FRONT_GAP_MIN elements opens a gap as long as itself, so
+    // a run of insert(0, x) costs amortized O(1) per call, like append.
+    template<typename T>
+    void insert_at(PY_VECTOR<T>& values, size_t index, T value) {
+        if (index == 0 && head == 0 && values.size() >= FRONT_GAP_MIN) {
+            head = values.size();
+            values.insert(values.begin(), head, T());
+        }
+        if (index == 0 && head > 0) {
+            values[--head] = std::move(value);
+        } else {
+            values.insert(values.begin() + head + index, std::move(value));
+        }
+    }
+
+    // Removing the front only advances head. The dead slots are dropped
+    // once they outnumber the elements two to one, which keeps a run of
+    // pops from the front amortized O(1) without undoing a gap that
+    // insert_at has just opened.
+    template<typename T>
+    void erase_at(PY_VECTOR<T>& values, size_t index) {
+        if (index == 0) {
+            values[head++] = T();
+        } else {
+            values.erase(values.begin() + head + index);
+        }
+        if (head == values.size()) {
+            values.clear();
+            head = 0;
+        } else if (head >= FRONT_GAP_MIN && head > 2 * (values.size() - head)) {
+            values.erase(values.begin(), values.begin() + head);
+            head = 0;
+        }
+    }
+
+    static PY_LIST_KIND storage_for_item(const PY_OJ& item) {
+        if (item.is_int()) return PY_LIST_KIND::INTS;
+        if (item.type() == PY_OJ_Type::FLOAT) return PY_LIST_KIND::FLOATS;
+        return PY_LIST_KIND::BOXED;
+    }
+
+    static PY_LIST_KIND storage_for(const std::vector<PY_OJ>& values) {
+        if (values.empty()) return PY_LIST_KIND::BOXED;
+        PY_LIST_KIND kind = storage_for_item(values.front());
+        for (const PY_OJ& value : values) {
+            if (storage_for_item(value) != kind) return PY_LIST_KIND::BOXED;
+        }
+        return kind;
+    }
+};
+
+// The elements of a list, or of a step-1 VIEW, as one contiguous run of
+// INTS, FLOATS or BOXED storage (a view's is inside its source), so loops
+// read them straight from memory instead of dispatching on the list kind
+// for every element. A strided VIEW has no such run: its span has kind
+// VIEW and its elements are read through the list.
+struct PY_LIST_SPAN {
+    PY_LIST_KIND kind;
+    const void* data;           // element 0; nullptr for VIEW
+    size_t size;
+    const PY_LIST_OBJ* list;
+
+    const int64_t* ints() const { return static_cast<const int64_t*>(data); }
+    const float* floats() const { return static_cast<const float*>(data); }
+    const PY_OJ* items() const { return static_cast<const PY_OJ*>(data); }
+
+    PY_OJ get(size_t index) const {
+        switch (kind) {
+            case PY_LIST_KIND::INTS: return PY_OJ(ints()[index]);
+            case PY_LIST_KIND::FLOATS: return PY_OJ(floats()[index]);
+            case PY_LIST_KIND::BOXED: return items()[index];
+            default: return list->get(index);
+        }
+    }
+
+    // Calls f with element index as a const PY_OJ&. BOXED elements are
+    // passed by reference; unboxed ones are boxed into a scalar temporary.
+    template<typename F>
+    bool with_item(size_t index, F f) const {
+        if (kind == PY_LIST_KIND::BOXED) return f(items()[index]);
+        return f(get(index));
+    }
+};
+
+inline PY_LIST_SPAN PY_LIST_OBJ::span() const {
+    const PY_LIST_OBJ* storage = this;
+    size_t first = head;
+    if (kind == PY_LIST_KIND::VIEW) {
+        if (view->step != 1) return {PY_LIST_KIND::VIEW, nullptr, view->count, this};
+        storage = view->source;
+        first = storage->head + static_cast<size_t>(view->start);
+    }
+    switch (storage->kind) {
+        case PY_LIST_KIND::INTS: return {PY_LIST_KIND::INTS, storage->ints.data() + first, size(), this};
+        case PY_LIST_KIND::FLOATS: return {PY_LIST_KIND::FLOATS, storage->floats.data() + first, size(), this};
+        default: return {PY_LIST_KIND::BOXED, storage->items.data() + first, size(), this};
+    }
+}
+
+struct PY_BIGINT_OBJ : PY_OBJ_HEAD {
+    PY_BIGINT value;
+
+    explicit PY_BIGINT_OBJ(const PY_BIGINT& val) : value(val) {}
+};
+
+// Python dict. Entries live densely in insertion order, which is also the
+// order dicts are iterated and printed in, as in CPython. They are found
+// through an open-addressing index laid out like a Swiss table: every slot
+// has one control byte, EMPTY or the low 7 bits of its entry's hash, and a
+// probe compares a whole group of 16 control bytes with the wanted 7 bits
+// at once (one SSE2 compare), so entries are only read for slots whose
+// bits match. Groups are probed quadratically; the index is kept at most
+// 7/8 full and rebuilt at twice the size when it fills up. Keys are never
+// removed, so there are no tombstones.
+struct PY_DICT_ENTRY {
+    size_t hash;  // py_key_hash(key)
+    PY_OJ key;
+    PY_OJ value;
+};
+
+struct PY_DICT_OBJ : PY_OBJ_HEAD {
+    static constexpr size_t GROUP = 16;
+    static constexpr uint8_t EMPTY = 0x80;
+
+    PY_VECTOR<PY_DICT_ENTRY> entries;
+    PY_VECTOR<uint8_t> ctrl;     // control byte of every slot
+    PY_VECTOR<uint32_t> slots;   // entries index of every full slot
+
+    size_t size() const { return entries.size(); }
+
+    // Index in entries of key, whose py_key_hash() is hash, or -1.
+    ptrdiff_t find(const PY_OJ& key, size_t hash) const;
+
+    // Sets the value of key, adding it at the end if it is new.
+    void set(const PY_OJ& key, size_t hash, PY_OJ value);
+
+    // Sizes the index for count entries up front.
+    void reserve(size_t count);
+
+private:
+    static uint32_t match(const uint8_t* group, uint8_t byte);
+    void place(size_t hash, uint32_t index);
+    void rehash(size_t capacity);
+};
+
+// Ints that fit the machine-width fast path are never stored as bigints,
+// so is_int() alone decides whether the fast path applies.
+inline PY_OJ::PY_OJ(const PY_BIGINT& val) {
+    if (val.fits_int64()) {
+        init_int(val.to_int64());
+    } else {
+        init_big(val);
+    }
+}
+
+inline PY_OJ::PY_OJ(const std::vector<PY_OJ>& val) {
+    init_list(new PY_LIST_OBJ(val));
+}
+
+inline PY_OJ::PY_OJ(std::vector<PY_OJ>&& val) {
+    init_list(new PY_LIST_OBJ(std::move(val)));
+}
+
+inline PY_OJ::PY_OJ(std::vector<int64_t> val) {
+    init_list(new PY_LIST_OBJ(std::move(val)));
+}
+
+inline PY_OJ::PY_OJ(std::vector<float> val) {
+    init_list(new PY_LIST_OBJ(std::move(val)));
+}
+
+#ifdef PY_OJ_TAGGED
+inline void PY_OJ::init_int(int64_t val) {
+    if (val >= SMALL_INT_MIN && val <= SMALL_INT_MAX) {
+        bits = static_cast<uint64_t>(val) << 3;
+    } else {
+        init_big(PY_BIGINT(val));
+    }
+}
+
+inline void PY_OJ::init_big(const PY_BIGINT& val) {
+    bits = reinterpret_cast<uint64_t>(new PY_BIGINT_OBJ(val)) | TAG_BIGINT;
+    PY_OJ_COUNT(allocations);
+}
+
+inline const PY_BIGINT& PY_OJ::big_value() const {
+    return reinterpret_cast<PY_BIGINT_OBJ*>(bits & ~uint64_t(TAG_MASK))->value;
+}
+
+inline std::string_view PY_OJ::str_view() const {
+    if (is_heap_string()) {
+        return str_obj()->view();
+    }
+    // Inline strings keep their length in bits 3-5 and their bytes in bytes 1-7.
+    // This relies on a little-endian word, like the rest of the tagged layout.
+    return std::string_view(reinterpret_cast<const char*>(&bits) + 1, (bits >> 3) & 7);
+}
+
+inline void PY_OJ::init_string(const char* data, size_t size) {
+    if (size <= PY_OJ_SSO_CAPACITY) {
+        bits = TAG_SSO | (static_cast<uint64_t>(size) << 3);
+        std::memcpy(reinterpret_cast<char*>(&bits) + 1, data, size);
+    } else {
+        bits = reinterpret_cast<uint64_t>(PY_STR_OBJ::create(data, size)) | TAG_STRING;
+        PY_OJ_COUNT(allocations);
+    }
+}
+
+inline void PY_OJ::init_heap_string(PY_STR_OBJ* str) {
+    bits = reinterpret_cast<uint64_t>(str) | TAG_STRING;
+    PY_OJ_COUNT(allocations);
+}
+
+inline void PY_OJ::init_list(PY_LIST_OBJ* list) {
+    bits = reinterpret_cast<uint64_t>(list) | TAG_LIST;
+    PY_OJ_COUNT(allocations);
+}
+
+inline void PY_OJ::init_dict(PY_DICT_OBJ* dict) {
+    bits = reinterpret_cast<uint64_t>(dict) | TAG_DICT;
+    PY_OJ_COUNT(allocations);
+}
+
+// Shared heap object behind this value, or nullptr for immediates.
+inline PY_OBJ_HEAD* PY_OJ::heap_payload() const {
+    uint64_t tag = bits & TAG_MASK;
+    if (tag == TAG_STRING || tag == TAG_LIST || tag == TAG_BIGINT || tag == TAG_DICT) {
+        return reinterpret_cast<PY_OBJ_HEAD*>(bits & ~uint64_t(TAG_MASK));
+    }
+    return nullptr;
+}
+
+inline void PY_OJ::copy_payload(const PY_OJ& other) {
+    bits = other.bits;
+    if (PY_OBJ_HEAD* head = heap_payload()) {
+        ++head->refcount;
+    }
+}
+
+inline void PY_OJ::release() noexcept {
+    PY_OBJ_HEAD* head = heap_payload();
+    if (head && --head->refcount == 0) {
+        switch (bits & TAG_MASK) {
+            case TAG_LIST: delete static_cast<PY_LIST_OBJ*>(head); break;
+            case TAG_DICT: delete static_cast<PY_DICT_OBJ*>(head); break;
+            case TAG_BIGINT: delete static_cast<PY_BIGINT_OBJ*>(head); break;
+            default: PY_STR_OBJ::destroy(static_cast<PY_STR_OBJ*>(head)); break;
+        }
+    }
+}
+#else
+inline void PY_OJ::init_int(int64_t val) {
+    i = val;
+    active_type = PY_OJ_Type::INT;
+}
+
+inline void PY_OJ::init_big(const PY_BIGINT& val) {
+    big = new PY_BIGINT_OBJ(val);
+    active_type = PY_OJ_Type::INT;
+    sso_len = PY_OJ_ON_HEAP;
+    PY_OJ_COUNT(allocations);
+}
+
+inline const PY_BIGINT& PY_OJ::big_value() const {
+    return big->value;
+}
+
+inline std::string_view PY_OJ::str_view() const {
+    return is_heap_string() ? s->view() : std::string_view(sso, sso_len);
+}
+
+inline void PY_OJ::init_string(const char* data, size_t size) {
+    active_type = PY_OJ_Type::STRING;
+    if (size <= PY_OJ_SSO_CAPACITY) {
+        std::memcpy(sso, data, size);
+        sso_len = static_cast<unsigned char>(size);
+    } else {
+        s = PY_STR_OBJ::create(data, size);
+        sso_len = PY_OJ_ON_HEAP;
+        PY_OJ_COUNT(allocations);
+    }
+}
+
+inline void PY_OJ::init_heap_string(PY_STR_OBJ* str) {
+    s = str;
+    active_type = PY_OJ_Type::STRING;
+    sso_len = PY_OJ_ON_HEAP;
+    PY_OJ_COUNT(allocations);
+}
+
+inline void PY_OJ::init_list(PY_LIST_OBJ* list) {
+    l = list;
+    active_type = PY_OJ_Type::LIST;
+    PY_OJ_COUNT(allocations);
+}
+
+inline void PY_OJ::init_dict(PY_DICT_OBJ* dict) {
+    d = dict;
+    active_type = PY_OJ_Type::DICT;
+    PY_OJ_COUNT(allocations);
+}
+
+// Shared heap object behind this value, or nullptr for scalars and inline strings.
+inline PY_OBJ_HEAD* PY_OJ::heap_payload() const {
+    if (active_type == PY_OJ_Type::LIST) return l;
+    if (active_type == PY_OJ_Type::DICT) return d;
+    if (active_type == PY_OJ_Type::STRING && is_heap_string()) return s;
+    if (is_big_int()) return big;
+    return nullptr;
+}
+
+inline void PY_OJ::copy_payload(const PY_OJ& other) {
+    std::memcpy(sso, other.sso, PY_OJ_SSO_CAPACITY);
+    active_type = other.active_type;
+    sso_len = other.sso_len;
+    if (PY_OBJ_HEAD* head = heap_payload()) {
+        ++head->refcount;
+    }
+}
+
+inline void PY_OJ::release() noexcept {
+    PY_OBJ_HEAD* head = heap_payload();
+    if (head && --head->refcount == 0) {
+        if (active_type == PY_OJ_Type::LIST) {
+            delete l;
+        } else if (active_type == PY_OJ_Type::DICT) {
+            delete d;
+        } else if (active_type == PY_OJ_Type::INT) {
+            delete big;
+        } else {
+            PY_STR_OBJ::destroy(s);
+        }
+    }
+}
+#endif
+
+inline bool PY_OJ::append_in_place(std::string_view extra) {
+    if (type() != PY_OJ_Type::STRING || !is_heap_string()) return false;
+    PY_STR_OBJ* str = str_obj();
+    if (str->refcount != 1 || str->owner) return false;
+    PY_STR_OBJ* grown = PY_STR_OBJ::append(str, extra);
+    if (grown != str) init_heap_string(grown);
+    return true;
+}
+
+// Numeric view of an INT, FLOAT or CHAR operand, used when a binary op promotes to float.
+inline float py_as_float(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::INT:
+            if (obj.is_big_int()) return static_cast<float>(obj.big_value().to_double());
+            return static_cast<float>(obj.int_value());
+        case PY_OJ_Type::FLOAT: return obj.float_value();
+        case PY_OJ_Type::CHAR: return static_cast<float>(obj.char_value());
+        default: throw std::runtime_error("Expected a numeric operand");
+    }
+}
+
+// Any INT operand, small or big, as a PY_BIGINT. Only used on the slow path
+// after a machine-width operation overflowed or a bigint was involved.
+inline PY_BIGINT py_as_bigint(const PY_OJ& obj) {
+    return obj.is_big_int() ? obj.big_value() : PY_BIGINT(obj.int_value());
+}
+
+// Decimal text of an INT operand.
+inline std::string py_int_text(const PY_OJ& obj) {
+    return obj.is_big_int() ? obj.big_value().to_string() : std::to_string(obj.int_value());
+}
+
+// Appends the textual form of obj to out, as Python's str() would (repr()
+// for elements nested in a list).
+void py_append_text(std::string& out, const PY_OJ& obj, bool nested = false);
+
+inline bool py_is_text(const PY_OJ& obj) {
+    return obj.type() == PY_OJ_Type::STRING || obj.type() == PY_OJ_Type::CHAR;
+}
+
+// Bytes of a STRING or CHAR operand; a CHAR is copied into buffer.
+inline std::string_view py_text_bytes(const PY_OJ& obj, char& buffer) {
+    if (obj.type() == PY_OJ_Type::CHAR) {
+        buffer = obj.char_value();
+        return std::string_view(&buffer, 1);
+    }
+    return obj.str_view();
+}
+
+// A STRING of size bytes that fill(char* out) writes, straight into a heap
+// block of exactly that size (or inline if it is short), so building a
+// result costs one allocation and no intermediate std::string.
+template<typename Fill>
+PY_OJ py_make_string(size_t size, Fill fill) {
+    if (size <= PY_OJ_SSO_CAPACITY) {
+        char buffer[PY_OJ_SSO_CAPACITY];
+        fill(buffer);
+        return PY_OJ(std::string(buffer, size));
+    }
+    PY_STR_OBJ* str = PY_STR_OBJ::create("", 0, size);
+    fill(str->bytes());
+    str->size = size;
+    return PY_OJ(str);
+}
+
+inline PY_OJ py_concat(std::string_view left, std::string_view right) {
+    return py_make_string(left.size() + right.size(), [&](char* out) {
+        std::memcpy(out, left.data(), left.size());
+        std::memcpy(out + left.size(), right.data(), right.size());
+    });
+}
+
+// Binary-op dispatch: every operator owns a table of handlers indexed by
+// (lhs.type(), rhs.type()), so picking the implementation is one
+// indexed load and scalar operands are never copied or allocated.
+using PY_BINOP_FN = PY_OJ (*)(const PY_OJ&, const PY_OJ&);
+constexpr int PY_OJ_TYPE_COUNT = 6;
+using PY_BINOP_TABLE = PY_BINOP_FN[PY_OJ_TYPE_COUNT][PY_OJ_TYPE_COUNT];
+
+inline PY_OJ py_dispatch(const PY_BINOP_TABLE& table, const PY_OJ& a, const PY_OJ& b) {
+    return table[static_cast<int>(a.type())][static_cast<int>(b.type())](a, b);
+}
+
+// One table per operator, defined with its handlers in PY2.cpp.
+extern const PY_BINOP_TABLE PY_ADD_TABLE;
+extern const PY_BINOP_TABLE PY_SUB_TABLE;
+extern const PY_BINOP_TABLE PY_MULT_TABLE;
+extern const PY_BINOP_TABLE PY_DIV_TABLE;
+
+// INT op INT is by far the most common pair in transpiled code, so it is
+// checked inline before falling back to the table. Overflow and bigint
+// operands drop through to the table's INT handler.
+inline PY_OJ PY_ADD(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_add_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return py_dispatch(PY_ADD_TABLE, a, b);
+}
+
+// a + b where a is a temporary or a local's last use (the transpiler emits
+// s = PY_ADD(std::move(s), x) for s = s + x and s += x): an unshared heap
+// string a is extended in place instead of copied, so building a string
+// piece by piece, or a chain a + b + c + ..., is linear overall.
+inline PY_OJ PY_ADD(PY_OJ&& a, const PY_OJ& b) {
+    char c;
+    if (a.type() == PY_OJ_Type::STRING && py_is_text(b) && a.append_in_place(py_text_bytes(b, c))) {
+        return std::move(a);
+    }
+    return PY_ADD(static_cast<const PY_OJ&>(a), b);
+}
+
+inline PY_OJ PY_SUB(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_sub_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return py_dispatch(PY_SUB_TABLE, a, b);
+}
+
+inline PY_OJ PY_MULT(const PY_OJ& a, const PY_OJ& b) {
+    int64_t result;
+    if (a.is_int() && b.is_int() && !__builtin_mul_overflow(a.int_value(), b.int_value(), &result)) {
+        return PY_OJ(result);
+    }
+    return py_dispatch(PY_MULT_TABLE, a, b);
+}
+
+inline PY_OJ PY_DIV(const PY_OJ& a, const PY_OJ& b) {
+    return py_dispatch(PY_DIV_TABLE, a, b);
+}
+
+// Variants emitted for binary-op sites that a type profile (--type-profile)
+// only ever saw with two floats, or two strings for +. The profiled case is
+// checked inline; anything else takes the generic path.
+inline bool py_both_floats(const PY_OJ& a, const PY_OJ& b) {
+    return a.type() == PY_OJ_Type::FLOAT && b.type() == PY_OJ_Type::FLOAT;
+}
+
+inline PY_OJ PY_ADD_FLOAT(const PY_OJ& a, const PY_OJ& b) {
+    return py_both_floats(a, b) ? PY_OJ(a.float_value() + b.float_value()) : PY_ADD(a, b);
+}
+
+inline PY_OJ PY_SUB_FLOAT(const PY_OJ& a, const PY_OJ& b) {
+    return py_both_floats(a, b) ? PY_OJ(a.float_value() - b.float_value()) : PY_SUB(a, b);
+}
+
+inline PY_OJ PY_MULT_FLOAT(const PY_OJ& a, const PY_OJ& b) {
+    return py_both_floats(a, b) ? PY_OJ(a.float_value() * b.float_value()) : PY_MULT(a, b);
+}
+
+inline PY_OJ PY_DIV_FLOAT(const PY_OJ& a, const PY_OJ& b) {
+    return py_both_floats(a, b) && b.float_value() != 0 ? PY_OJ(a.float_value() / b.float_value()) : PY_DIV(a, b);
+}
+
+inline PY_OJ PY_ADD_STR(const PY_OJ& a, const PY_OJ& b) {
+    if (a.type() != PY_OJ_Type::STRING || b.type() != PY_OJ_Type::STRING) return PY_ADD(a, b);
+    return py_concat(a.str_view(), b.str_view());
+}
+
+inline PY_OJ PY_ADD_STR(PY_OJ&& a, const PY_OJ& b) {
+    if (a.type() == PY_OJ_Type::STRING && b.type() == PY_OJ_Type::STRING && a.append_in_place(b.str_view())) {
+        return std::move(a);
+    }
+    return PY_ADD_STR(static_cast<const PY_OJ&>(a), b);
+}
+
+// Division in natively specialized int/float code: like PY_DIV, / always
+// yields a float and dividing by zero throws.
+inline float PY_NATIVE_DIV(float a, float b) {
+    if (b == 0) {
+        throw std::runtime_error("Division by zero");
+    }
+    return a / b;
+}
+
+// Natively specialized int code works on int64_t and cannot represent a
+// bigint, so its arithmetic is checked: on overflow it throws
+// PY_INT_OVERFLOW and the caller reruns the call on boxed PY_OJ values,
+// which promote to PY_BIGINT instead.
+struct PY_INT_OVERFLOW : std::overflow_error {
+    PY_INT_OVERFLOW() : std::overflow_error("int64 overflow in native code") {}
+};
+
+inline int64_t PY_CHECKED_ADD(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_add_overflow(a, b, &result)) throw PY_INT_OVERFLOW();
+    return result;
+}
+
+inline int64_t PY_CHECKED_SUB(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_sub_overflow(a, b, &result)) throw PY_INT_OVERFLOW();
+    return result;
+}
+
+inline int64_t PY_CHECKED_MULT(int64_t a, int64_t b) {
+    int64_t result;
+    if (__builtin_mul_overflow(a, b, &result)) throw PY_INT_OVERFLOW();
+    return result;
+}
+
+// Entry of a boxed function with a native version, once its parameters
+// passed the type guard: returns the native result, or falls through to
+// the generic body if the native version overflowed. Until that body
+// returns, no boxed entry tries its native version again; otherwise every
+// recursive call of the fallback would rerun the native code down the rest
+// of the stack and overflow again, making deep recursions quadratic.
+struct PY_NATIVE_FALLBACK {
+    static inline PY_THREAD_LOCAL bool active = false;
+    bool owner = false;
+
+    void enter() { active = owner = true; }
+    ~PY_NATIVE_FALLBACK() {
+        if (owner) active = false;
+    }
+};
+
+#define PY_GUARDED_NATIVE(fallback, native_call) \
+    try { \
+        return PY_OJ(native_call); \
+    } catch (const PY_INT_OVERFLOW&) { \
+        fallback.enter(); \
+    }
+
+// Evaluates native_call, or boxed_call if the native version overflowed.
+#define PY_NATIVE_CALL(native_call, boxed_call) \
+    ([&]() -> PY_OJ { \
+        try { \
+            return PY_OJ(native_call); \
+        } catch (const PY_INT_OVERFLOW&) { \
+            return boxed_call; \
+        } \
+    }())
+
+inline PY_OJ PY_LIST_APPEND(PY_OJ& list, const PY_OJ& item) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("Append can only be used on lists");
+    }
+    // Take a reference before appending, which may reallocate the storage
+    // item lives in (e.g. lst.append(lst[0])).
+    PY_OJ item_ref(item);
+    list.list_obj()->append(std::move(item_ref));
+    return PY_OJ(); // Return None
+}
+
+inline PY_OJ PY_LIST_APPEND(PY_OJ& list, PY_OJ&& item) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("Append can only be used on lists");
+    }
+    list.list_obj()->append(std::move(item));
+    return PY_OJ(); // Return None
+}
+
+// Shallow copy into a new, unshared list (Python's list.copy()).
+PY_OJ PY_LIST_COPY(const PY_OJ& list);
+
+PY_OJ PY_LIST_DELETE(PY_OJ& list, const PY_OJ& index);
+
+// list.pop() and list.pop(index): removes and returns an element, the last
+// one by default. Negative indices count from the end, as in Python.
+PY_OJ PY_LIST_POP(const PY_OJ& list);
+PY_OJ PY_LIST_POP(const PY_OJ& list, const PY_OJ& index);
+
+// list.insert(index, item). The index is clamped to the list, as in
+// Python, so insert(0, x) prepends and insert(len(l), x) appends.
+PY_OJ PY_LIST_INSERT(const PY_OJ& list, const PY_OJ& index, PY_OJ item);
+
+// Checked position of index in list, for subscripts.
+inline size_t py_list_index(const PY_LIST_OBJ* list, const PY_OJ& index) {
+    if (index.type() != PY_OJ_Type::INT) {
+        throw std::runtime_error("List index must be an integer");
+    }
+    int64_t idx = index.is_int() ? index.int_value() : -1;
+    if (idx < 0 || idx >= static_cast<int64_t>(list->size())) {
+        throw std::runtime_error("List index out of range");
+    }
+    return static_cast<size_t>(idx);
+}
+
+inline PY_OJ PY_LIST_GET(const PY_OJ& list, const PY_OJ& index) {
+    if (list.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("Subscript can only be used on lists and dicts");
+    }
+    return list.list_obj()->get(py_list_index(list.list_obj(), index));
+}
+
+// One bound or the step of a slice; {} when omitted.
+struct PY_SLICE_ARG {
+    bool given = false;
+    PY_OJ value;
+
+    PY_SLICE_ARG() = default;
+    PY_SLICE_ARG(const PY_OJ& value) : given(true), value(value) {}
+};
+
+// Lists up to this long are sliced by copying, which is cheaper than a
+// view for a handful of elements and leaves nothing shared.
+constexpr size_t PY_LIST_VIEW_MIN = 16;
+
+// obj[start:stop:step] on a list (a VIEW, see PY_LIST_KIND) or a string
+// (sharing the original's bytes when step is 1), with Python's clamping of
+// out-of-range and negative bounds.
+PY_OJ PY_SLICE(const PY_OJ& obj, const PY_SLICE_ARG& start, const PY_SLICE_ARG& stop, const PY_SLICE_ARG& step = {});
+
+// Python truthiness, for if/while conditions that are not comparisons.
+inline bool PY_TRUTH(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::INT: return obj.is_big_int() || obj.int_value() != 0;
+        case PY_OJ_Type::FLOAT: return obj.float_value() != 0;
+        case PY_OJ_Type::CHAR: return true;
+        case PY_OJ_Type::STRING: return !obj.str_view().empty();
+        case PY_OJ_Type::LIST: return obj.list_obj()->size() != 0;
+        case PY_OJ_Type::DICT: return obj.dict_obj()->size() != 0;
+    }
+    return false;
+}
+
+// Bounds of a `for i in range(...)` loop. The transpiler lowers the loop to
+// a counted C++ loop over an int64_t, so range() never builds a list.
+inline int64_t PY_RANGE_ARG(const PY_OJ& value) {
+    if (!value.is_int()) {
+        throw std::runtime_error("range() arguments must be integers");
+    }
+    return value.int_value();
+}
+
+inline int64_t PY_RANGE_STEP(int64_t step) {
+    if (step == 0) {
+        throw std::runtime_error("range() arg 3 must not be zero");
+    }
+    return step;
+}
+
+inline int64_t PY_RANGE_STEP(const PY_OJ& step) {
+    return PY_RANGE_STEP(PY_RANGE_ARG(step));
+}
+
+// Cursor behind `for x in iterable` over a LIST, STRING or DICT (its keys).
+// It holds its own reference to the iterable and reads elements by index,
+// so the loop body may append to the list or add keys (the loop then visits
+// the new elements too) without invalidating the loop. Elements of unboxed
+// lists are boxed one at a time; the list itself is never copied.
+struct PY_ITER {
+    PY_OJ iterable;
+    size_t index = 0;
+
+    explicit PY_ITER(const PY_OJ& value) : iterable(value) {
+        PY_OJ_Type type = value.type();
+        if (type != PY_OJ_Type::LIST && type != PY_OJ_Type::STRING && type != PY_OJ_Type::DICT) {
+            throw std::runtime_error("Object is not iterable");
+        }
+    }
+
+    bool next(PY_OJ& out) {
+        if (iterable.type() == PY_OJ_Type::LIST) {
+            const PY_LIST_OBJ* list = iterable.list_obj();
+            if (index >= list->size()) return false;
+            out = list->get(index++);
+            return true;
+        }
+        if (iterable.type() == PY_OJ_Type::DICT) {
+            const PY_DICT_OBJ* dict = iterable.dict_obj();
+            if (index >= dict->size()) return false;
+            out = dict->entries[index++].key;
+            return true;
+        }
+        std::string_view str = iterable.str_view();
+        if (index >= str.size()) return false;
+        out = PY_OJ(std::string(1, str[index++]));
+        return true;
+    }
+};
+
+// Parallel maps, emitted by the transpiler's --parallel mode for a list
+// comprehension [e for x in xs] whose element e only reads values and calls
+// pure functions. Elements are computed in any order, on any thread, but
+// each result is stored at its element's index, so the list comes out in
+// input order. Without -DPY_OJ_THREADS, or inside another parallel map,
+// they run serially on the calling thread.
+#ifdef PY_OJ_THREADS
+// Calls body(begin, end) on chunks that cover [0, count) once each, on the
+// pool's threads and the calling one, and returns when all are done. The
+// first exception a chunk throws is rethrown here; chunks that have not
+// started by then are skipped.
+void py_parallel_for(size_t count, const std::function<void(size_t, size_t)>& body);
+
+// Threads a parallel map runs on, the calling thread included. Defaults to
+// $PY_THREADS, or else the number of hardware threads.
+void py_set_threads(size_t count);
+size_t py_thread_count();
+#endif
+
+template<typename Body>
+inline void py_parallel_run(size_t count, Body body) {
+#ifdef PY_OJ_THREADS
+    py_parallel_for(count, body);
+#else
+    body(0, count);
+#endif
+}
+
+// [f(x) for x in iterable]. Strings and dicts are mapped serially.
+template<typename F>
+PY_OJ PY_PARALLEL_MAP(const PY_OJ& iterable, F f) {
+    if (iterable.type() != PY_OJ_Type::LIST) {
+        std::vector<PY_OJ> results;
+        PY_OJ item;
+        for (PY_ITER cursor(iterable); cursor.next(item); ) results.push_back(f(item));
+        return PY_OJ(std::move(results));
+    }
+    PY_LIST_SPAN span = iterable.list_obj()->span();
+    std::vector<PY_OJ> results(span.size);
+    py_parallel_run(results.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            span.with_item(i, [&](const PY_OJ& item) {
+                results[i] = f(item);
+                return true;
+            });
+        }
+    });
+    return PY_OJ(std::move(results));
+}
+
+// [f(i) for i in range(start, stop, step)]; step is not 0 (PY_RANGE_STEP).
+template<typename F>
+PY_OJ PY_PARALLEL_RANGE(int64_t start, int64_t stop, int64_t step, F f) {
+    uint64_t count = 0;
+    if (step > 0 && start < stop) {
+        count = (static_cast<uint64_t>(stop) - static_cast<uint64_t>(start) - 1) / static_cast<uint64_t>(step) + 1;
+    } else if (step < 0 && start > stop) {
+        count = (static_cast<uint64_t>(start) - static_cast<uint64_t>(stop) - 1) / (0 - static_cast<uint64_t>(step)) + 1;
+    }
+    std::vector<PY_OJ> results(count);
+    py_parallel_run(results.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = f(PY_OJ(static_cast<int64_t>(static_cast<uint64_t>(start) + i * static_cast<uint64_t>(step))));
+        }
+    });
+    return PY_OJ(std::move(results));
+}
+
+// Comparisons read both operands in place: numbers by value, strings as
+// views, lists element by element. The operand types are combined into one
+// tag pair for a single switch, like the binary-op tables.
+constexpr int py_type_pair(PY_OJ_Type a, PY_OJ_Type b) {
+    return static_cast<int>(a) * PY_OJ_TYPE_COUNT + static_cast<int>(b);
+}
+
+template<typename Op>
+constexpr bool py_is_equality_op() {
+    return std::is_same_v<Op, std::equal_to<>> || std::is_same_v<Op, std::not_equal_to<>>;
+}
+
+// Numeric value of an INT, FLOAT or CHAR operand for mixed-type comparisons.
+inline double py_compare_double(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::INT: return obj.is_big_int() ? obj.big_value().to_double() : static_cast<double>(obj.int_value());
+        case PY_OJ_Type::FLOAT: return obj.float_value();
+        default: return static_cast<double>(obj.char_value());
+    }
+}
+
+// Text of a STRING or CHAR operand (a char compares as a 1-character string).
+inline std::string_view py_compare_text(const PY_OJ& obj, char& storage) {
+    if (obj.type() == PY_OJ_Type::STRING) return obj.str_view();
+    storage = obj.char_value();
+    return std::string_view(&storage, 1);
+}
+
+template<typename Op>
+bool PY_COMPARE(const PY_OJ& a, Op op, const PY_OJ& b);
+
+bool py_equal(const PY_OJ& a, const PY_OJ& b);
+
+// Same keys with equal values, in any order.
+bool py_dict_equal(const PY_DICT_OBJ* a, const PY_DICT_OBJ* b);
+
+// Calls f with element i of list as a const PY_OJ&, as PY_LIST_SPAN::with_item.
+template<typename F>
+inline bool py_with_item(const PY_LIST_OBJ* list, size_t i, F f) {
+    return list->span().with_item(i, f);
+}
+
+// The same comparison over two runs of unboxed elements.
+template<typename T, typename Op>
+bool py_compare_ranges(const T* a, size_t a_size, Op op, const T* b, size_t b_size) {
+    size_t common = std::min(a_size, b_size);
+    for (size_t i = 0; i < common; ++i) {
+        if (a[i] != b[i]) return op(a[i], b[i]);
+    }
+    return op(a_size, b_size);
+}
+
+// Lexicographic list comparison, as in Python: find the first pair of
+// elements that are not equal and compare those, otherwise compare lengths.
+template<typename Op>
+bool py_compare_lists(const PY_LIST_OBJ* a, Op op, const PY_LIST_OBJ* b) {
+    PY_LIST_SPAN x = a->span(), y = b->span();
+    if (x.kind == y.kind && x.kind == PY_LIST_KIND::INTS) {
+        return py_compare_ranges(x.ints(), x.size, op, y.ints(), y.size);
+    }
+    if (x.kind == y.kind && x.kind == PY_LIST_KIND::FLOATS) {
+        return py_compare_ranges(x.floats(), x.size, op, y.floats(), y.size);
+    }
+    if (py_is_equality_op<Op>() && x.size != y.size) {
+        return op(x.size, y.size);
+    }
+    size_t common = std::min(x.size, y.size);
+    for (size_t i = 0; i < common; ++i) {
+        bool differs = x.with_item(i, [&](const PY_OJ& u) {
+            return y.with_item(i, [&](const PY_OJ& v) { return !py_equal(u, v); });
+        });
+        if (differs) {
+            if constexpr (py_is_equality_op<Op>()) {
+                return op(0, 1);
+            } else {
+                return x.with_item(i, [&](const PY_OJ& u) {
+                    return y.with_item(i, [&](const PY_OJ& v) { return PY_COMPARE(u, op, v); });
+                });
+            }
+        }
+    }
+    return op(x.size, y.size);
+}
+
+template<typename Op>
+bool PY_COMPARE(const PY_OJ& a, Op op, const PY_OJ& b) {
+    switch (py_type_pair(a.type(), b.type())) {
+        case py_type_pair(PY_OJ_Type::INT, PY_OJ_Type::INT):
+            if (a.is_int() && b.is_int()) {
+                return op(a.int_value(), b.int_value());
+            }
+            return op(compare(py_as_bigint(a), py_as_bigint(b)), 0);
+        case py_type_pair(PY_OJ_Type::FLOAT, PY_OJ_Type::FLOAT):
+            return op(a.float_value(), b.float_value());
+        case py_type_pair(PY_OJ_Type::CHAR, PY_OJ_Type::CHAR):
+            return op(a.char_value(), b.char_value());
+        case py_type_pair(PY_OJ_Type::INT, PY_OJ_Type::FLOAT):
+        case py_type_pair(PY_OJ_Type::INT, PY_OJ_Type::CHAR):
+        case py_type_pair(PY_OJ_Type::FLOAT, PY_OJ_Type::INT):
+        case py_type_pair(PY_OJ_Type::FLOAT, PY_OJ_Type::CHAR):
+        case py_type_pair(PY_OJ_Type::CHAR, PY_OJ_Type::INT):
+        case py_type_pair(PY_OJ_Type::CHAR, PY_OJ_Type::FLOAT):
+            return op(py_compare_double(a), py_compare_double(b));
+        case py_type_pair(PY_OJ_Type::STRING, PY_OJ_Type::STRING):
+            return op(a.str_view(), b.str_view());
+        case py_type_pair(PY_OJ_Type::STRING, PY_OJ_Type::CHAR):
+        case py_type_pair(PY_OJ_Type::CHAR, PY_OJ_Type::STRING): {
+            char a_char, b_char;
+            return op(py_compare_text(a, a_char), py_compare_text(b, b_char));
+        }
+        case py_type_pair(PY_OJ_Type::LIST, PY_OJ_Type::LIST):
+            return py_compare_lists(a.list_obj(), op, b.list_obj());
+        case py_type_pair(PY_OJ_Type::DICT, PY_OJ_Type::DICT):
+            if constexpr (py_is_equality_op<Op>()) {
+                return op(py_dict_equal(a.dict_obj(), b.dict_obj()) ? 0 : 1, 0);
+            } else {
+                throw std::runtime_error("Dicts cannot be ordered");
+            }
+        default:
+            // Values of unrelated types are never equal and cannot be ordered
+            if constexpr (py_is_equality_op<Op>()) {
+                return op(0, 1);
+            } else {
+                throw std::runtime_error("Incompatible types for comparison");
+            }
+    }
+}
+
+inline bool operator<(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::less<>(), b);
+}
+
+inline bool operator<=(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::less_equal<>(), b);
+}
+
+inline bool operator>(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::greater<>(), b);
+}
+
+inline bool operator>=(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::greater_equal<>(), b);
+}
+
+inline bool operator==(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::equal_to<>(), b);
+}
+
+inline bool operator!=(const PY_OJ& a, const PY_OJ& b) {
+    return PY_COMPARE(a, std::not_equal_to<>(), b);
+}
+
+// Builtins over lists: len(), sum(), min() and max(). Unboxed INTS and
+// FLOATS lists are reduced straight over their contiguous arrays; BOXED
+// lists go through the generic operators.
+inline PY_OJ PY_LEN(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::LIST: return PY_OJ(static_cast<int64_t>(obj.list_obj()->size()));
+        case PY_OJ_Type::STRING: return PY_OJ(static_cast<int64_t>(obj.str_view().size()));
+        case PY_OJ_Type::DICT: return PY_OJ(static_cast<int64_t>(obj.dict_obj()->size()));
+        default: throw std::runtime_error("Object has no len()");
+    }
+}
+
+PY_OJ PY_SUM(const PY_OJ& list);
+PY_OJ PY_MIN(const PY_OJ& list);
+PY_OJ PY_MAX(const PY_OJ& list);
+
+// Hash of a PY_OJ value: py_key_hash() for everything a dict accepts as a
+// key; lists and dicts are mutable and hash by identity.
+size_t PY_HASH(const PY_OJ& obj);
+
+struct PY_OJ_Hash {
+    size_t operator()(const PY_OJ& obj) const { return PY_HASH(obj); }
+};
+
+// Same type and same value. Unlike ==, 1 and 1.0 are different keys here,
+// because a memoized call must return exactly what the original would.
+bool py_same_value(const PY_OJ& a, const PY_OJ& b);
+
+// Dicts. Keys hash consistently with ==: an int, an integral float and a
+// bigint of the same value hash alike, and a char hashes as the 1-character
+// string. Lists and dicts are mutable and cannot be keys.
+inline size_t py_mix_hash(uint64_t x) {
+    // fmix64 of MurmurHash3, so the 7 control bits and the group bits are
+    // both well distributed even for sequential ints
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+}
+
+inline size_t py_double_hash(double value) {
+    if (value >= -9.2e18 && value <= 9.2e18 && static_cast<double>(static_cast<int64_t>(value)) == value) {
+        return py_mix_hash(static_cast<uint64_t>(static_cast<int64_t>(value)));
+    }
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return py_mix_hash(bits);
+}
+
+inline size_t py_text_hash(std::string_view text) {
+    return py_mix_hash(std::hash<std::string_view>()(text));
+}
+
+inline size_t py_key_hash(const PY_OJ& key) {
+    switch (key.type()) {
+        case PY_OJ_Type::INT:
+            if (key.is_int()) return py_mix_hash(static_cast<uint64_t>(key.int_value()));
+            if (key.big_value().fits_int64()) return py_mix_hash(static_cast<uint64_t>(key.big_value().to_int64()));
+            return py_double_hash(key.big_value().to_double());
+        case PY_OJ_Type::FLOAT: return py_double_hash(key.float_value());
+        case PY_OJ_Type::CHAR: {
+            char c = key.char_value();
+            return py_text_hash(std::string_view(&c, 1));
+        }
+        case PY_OJ_Type::STRING: {
+            if (!key.is_heap_string()) return py_text_hash(key.str_view());
+            // A heap string only changes while nothing else references it
+            // (and then resets its hash), so the hash is computed once
+            const PY_STR_OBJ* str = key.str_obj();
+            size_t hash = str->hash;
+            if (hash == 0) str->hash = hash = py_text_hash(str->view());
+            return hash;
+        }
+        default: throw std::runtime_error("unhashable type: '" + std::string(key.type() == PY_OJ_Type::LIST ? "list" : "dict") + "'");
+    }
+}
+
+// Key equality with the common same-type cases inlined.
+inline bool py_key_equal(const PY_OJ& a, const PY_OJ& b) {
+    if (a.is_int() && b.is_int()) return a.int_value() == b.int_value();
+    if (a.type() == PY_OJ_Type::STRING && b.type() == PY_OJ_Type::STRING) return a.str_view() == b.str_view();
+    return py_equal(a, b);
+}
+
+// Bit i is set where group[i] == byte.
+inline uint32_t PY_DICT_OBJ::match(const uint8_t* group, uint8_t byte) {
+#ifdef __SSE2__
+    __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(static_cast<char>(byte)))));
+#else
+    uint32_t bits = 0;
+    for (size_t i = 0; i < GROUP; ++i) bits |= static_cast<uint32_t>(group[i] == byte) << i;
+    return bits;
+#endif
+}
+
+inline ptrdiff_t PY_DICT_OBJ::find(const PY_OJ& key, size_t hash) const {
+    if (ctrl.empty()) return -1;
+    uint8_t tag = hash & 0x7F;
+    size_t group_mask = ctrl.size() / GROUP - 1;
+    size_t group = (hash >> 7) & group_mask;
+    // Triangular steps visit every group of a power-of-two table
+    for (size_t step = 1;; ++step) {
+        const uint8_t* bytes = ctrl.data() + group * GROUP;
+        for (uint32_t bits = match(bytes, tag); bits != 0; bits &= bits - 1) {
+            uint32_t index = slots[group * GROUP + __builtin_ctz(bits)];
+            const PY_DICT_ENTRY& entry = entries[index];
+            if (entry.hash == hash && py_key_equal(entry.key, key)) return index;
+        }
+        if (match(bytes, EMPTY) != 0) return -1;
+        group = (group + step) & group_mask;
+    }
+}
+
+inline void PY_DICT_OBJ::place(size_t hash, uint32_t index) {
+    size_t group_mask = ctrl.size() / GROUP - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; ++step) {
+        uint32_t empty = match(ctrl.data() + group * GROUP, EMPTY);
+        if (empty != 0) {
+            size_t slot = group * GROUP + __builtin_ctz(empty);
+            ctrl[slot] = hash & 0x7F;
+            slots[slot] = index;
+            return;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+inline void PY_DICT_OBJ::set(const PY_OJ& key, size_t hash, PY_OJ value) {
+    ptrdiff_t found = find(key, hash);
+    if (found >= 0) {
+        entries[found].value = std::move(value);
+        return;
+    }
+    if ((entries.size() + 1) * 8 > ctrl.size() * 7) {
+        rehash(std::max(GROUP, ctrl.size() * 2));
+    }
+    entries.push_back(PY_DICT_ENTRY{hash, key, std::move(value)});
+    place(hash, static_cast<uint32_t>(entries.size() - 1));
+}
+
+inline void PY_DICT_OBJ::reserve(size_t count) {
+    size_t capacity = GROUP;
+    while (count * 8 > capacity * 7) capacity *= 2;
+    if (capacity > ctrl.size()) rehash(capacity);
+    entries.reserve(count);
+}
+
+// Dict display: {k: v, ...}. Later duplicates of a key overwrite its value.
+inline PY_OJ PY_DICT(std::initializer_list<std::pair<PY_OJ, PY_OJ>> items = {}) {
+    PY_DICT_OBJ* dict = new PY_DICT_OBJ;
+    PY_OJ result(dict);
+    dict->reserve(items.size());
+    for (const auto& item : items) dict->set(item.first, py_key_hash(item.first), item.second);
+    return result;
+}
+
+// Throws Python's KeyError for key.
+[[noreturn]] void py_key_error(const PY_OJ& key);
+
+// container[key] on a list or dict.
+inline PY_OJ PY_GETITEM(const PY_OJ& container, const PY_OJ& key) {
+    if (container.type() == PY_OJ_Type::DICT) {
+        const PY_DICT_OBJ* dict = container.dict_obj();
+        ptrdiff_t found = dict->find(key, py_key_hash(key));
+        if (found < 0) py_key_error(key);
+        return dict->entries[found].value;
+    }
+    return PY_LIST_GET(container, key);
+}
+
+// container[key] = value on a list or dict.
+inline void PY_SETITEM(const PY_OJ& container, const PY_OJ& key, PY_OJ value) {
+    if (container.type() == PY_OJ_Type::DICT) {
+        container.dict_obj()->set(key, py_key_hash(key), std::move(value));
+        return;
+    }
+    if (container.type() != PY_OJ_Type::LIST) {
+        throw std::runtime_error("Item assignment can only be used on lists and dicts");
+    }
+    container.list_obj()->set(py_list_index(container.list_obj(), key), std::move(value));
+}
+
+// `item in container`: a key of a dict, an element of a list (by ==) or a
+// substring of a string.
+inline bool PY_CONTAINS(const PY_OJ& container, const PY_OJ& item) {
+    switch (container.type()) {
+        case PY_OJ_Type::DICT:
+            return container.dict_obj()->find(item, py_key_hash(item)) >= 0;
+        case PY_OJ_Type::LIST: {
+            PY_LIST_SPAN span = container.list_obj()->span();
+            if (span.kind == PY_LIST_KIND::INTS && item.is_int()) {
+                const int64_t* values = span.ints();
+                return std::find(values, values + span.size, item.int_value()) != values + span.size;
+            }
+            for (size_t i = 0; i < span.size; ++i) {
+                if (span.with_item(i, [&](const PY_OJ& x) { return py_equal(x, item); })) return true;
+            }
+            return false;
+        }
+        case PY_OJ_Type::STRING: {
+            if (item.type() != PY_OJ_Type::STRING && item.type() != PY_OJ_Type::CHAR) {
+                throw std::runtime_error("'in <string>' requires a string as left operand");
+            }
+            char storage;
+            return container.str_view().find(py_compare_text(item, storage)) != std::string_view::npos;
+        }
+        default: throw std::runtime_error("Argument of 'in' is not iterable");
+    }
+}
+
+// dict.get(key, fallback); a missing key gives fallback. The one-argument
+// form is not transpiled, as there is no None to return.
+inline PY_OJ PY_DICT_GET(const PY_OJ& dict, const PY_OJ& key, const PY_OJ& fallback) {
+    if (dict.type() != PY_OJ_Type::DICT) {
+        throw std::runtime_error("get() can only be used on dicts");
+    }
+    const PY_DICT_OBJ* obj = dict.dict_obj();
+    ptrdiff_t found = obj->find(key, py_key_hash(key));
+    return found < 0 ? fallback : obj->entries[found].value;
+}
+
+// Result cache for a pure function of N arguments, emitted by the
+// transpiler's --memo mode. Calls with a list or dict argument bypass the
+// cache, since it could be mutated between calls, and list or dict results
+// are not cached, since every caller must get its own mutable copy.
+template<size_t N>
+struct PY_MEMO {
+    using Key = std::array<PY_OJ, N>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t seed = N;
+            for (const PY_OJ& arg : key) {
+                seed ^= PY_HASH(arg) + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+            }
+            return seed;
+        }
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key& a, const Key& b) const {
+            for (size_t i = 0; i < N; ++i) {
+                if (!py_same_value(a[i], b[i])) return false;
+            }
+            return true;
+        }
+    };
+
+    std::unordered_map<Key, PY_OJ, KeyHash, KeyEqual> table;
+
+    template<typename Compute>
+    PY_OJ call(Key key, Compute compute) {
+        for (const PY_OJ& arg : key) {
+            if (arg.type() == PY_OJ_Type::LIST || arg.type() == PY_OJ_Type::DICT) return compute();
+        }
+        auto hit = table.find(key);
+        if (hit != table.end()) return hit->second;
+        // compute() may recurse into this cache, so no iterator is held across it
+        PY_OJ result = compute();
+        // A cached list or dict would be shared by every later caller
+        if (result.type() != PY_OJ_Type::LIST && result.type() != PY_OJ_Type::DICT) {
+            table.emplace(std::move(key), result);
+        }
+        return result;
+    }
+};
+
+// Output engine behind PY_PRINT. Values are formatted straight into one
+// reusable buffer, which is written to stdout only when it fills up, on
+// PY_FLUSH() and at exit (including std::terminate after an uncaught
+// exception). Code that also writes to std::cout or stdout directly must
+// call PY_FLUSH() first to keep the output in order.
+struct PY_OUTPUT {
+    static constexpr size_t CAPACITY = 1 << 16;
+    std::string buffer;
+
+    PY_OUTPUT() {
+        buffer.reserve(CAPACITY);
+        previous_terminate = std::set_terminate(flush_and_terminate);
+    }
+    ~PY_OUTPUT() { flush(); }
+
+    void flush() {
+        if (!buffer.empty()) {
+            std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+            buffer.clear();
+        }
+        std::fflush(stdout);
+    }
+
+    void end_line() {
+        buffer += '\n';
+        if (buffer.size() >= CAPACITY) flush();
+    }
+
+private:
+    static inline std::terminate_handler previous_terminate = nullptr;
+    static void flush_and_terminate();
+};
+
+inline PY_OUTPUT py_output;
+
+inline void PY_OUTPUT::flush_and_terminate() {
+    py_output.flush();
+    if (previous_terminate) previous_terminate();
+    std::abort();
+}
+
+inline void PY_FLUSH() {
+    py_output.flush();
+}
+
+// Writes one print() argument. Comparisons yield a C++ bool, printed as
+// Python's True/False; the template keeps ints from converting to bool.
+inline void py_print_value(const PY_OJ& obj) {
+    py_append_text(py_output.buffer, obj);
+}
+
+template<typename T, std::enable_if_t<std::is_same_v<T, bool>, int> = 0>
+inline void py_print_value(T value) {
+    py_output.buffer += value ? "True" : "False";
+}
+
+// Kept for callers that print a single value without a newline.
+inline void print_py_oj(const PY_OJ& obj) {
+    py_print_value(obj);
+}
+
+// print(): arguments separated by single spaces, then a newline.
+inline void PY_PRINT() {
+    py_output.end_line();
+}
+
+template<typename First, typename... Rest>
+inline void PY_PRINT(const First& first, const Rest&... rest) {
+    py_print_value(first);
+    ((py_output.buffer += ' ', py_print_value(rest)), ...);
+    py_output.end_line();
+}
+
+// Per-function profile for code transpiled with --profile. Every Python
+// function gets a file-scope PY_PROFILE_ENTRY and opens a PY_PROFILE scope
+// on entry, which counts the call and times it with the TSC (steady_clock
+// on other targets). Inclusive time counts only the outermost activation of
+// a recursive function; self time excludes time spent in profiled callees.
+// The table goes to stderr at exit, sorted by self time.
+inline uint64_t py_profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct PY_PROFILE_ENTRY {
+    const char* name;
+    int line;
+    uint64_t calls = 0;
+    uint64_t inclusive = 0;
+    uint64_t self = 0;
+    uint32_t active = 0;
+
+    PY_PROFILE_ENTRY(const char* name, int line);
+};
+
+struct PY_PROFILER {
+    std::vector<PY_PROFILE_ENTRY*> entries;
+    uint64_t start_ticks = py_profile_ticks();
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    ~PY_PROFILER() { report(); }
+
+    void report();
+};
+
+inline PY_PROFILER py_profiler;
+
+inline PY_PROFILE_ENTRY::PY_PROFILE_ENTRY(const char* name, int line) : name(name), line(line) {
+    py_profiler.entries.push_back(this);
+}
+
+struct PY_PROFILE_SCOPE {
+    PY_PROFILE_ENTRY& entry;
+    PY_PROFILE_SCOPE* parent;
+    uint64_t start;
+    uint64_t children = 0;
+
+    static inline PY_PROFILE_SCOPE* current = nullptr;
+
+    explicit PY_PROFILE_SCOPE(PY_PROFILE_ENTRY& entry) : entry(entry), parent(current) {
+        ++entry.calls;
+        ++entry.active;
+        current = this;
+        start = py_profile_ticks();
+    }
+
+    ~PY_PROFILE_SCOPE() {
+        uint64_t elapsed = py_profile_ticks() - start;
+        if (--entry.active == 0) entry.inclusive += elapsed;
+        entry.self += elapsed - std::min(children, elapsed);
+        if (parent) parent->children += elapsed;
+        current = parent;
+    }
+
+    PY_PROFILE_SCOPE(const PY_PROFILE_SCOPE&) = delete;
+    PY_PROFILE_SCOPE& operator=(const PY_PROFILE_SCOPE&) = delete;
+};
+
+#define PY_PROFILE(entry) PY_PROFILE_SCOPE py_profile_scope(entry)
+
+// Type profile for code transpiled with --type-profile-gen. Every boxed
+// function records the types of its arguments on entry and every binary-op
+// site the types of its operands; at exit the observed type tuples and
+// their counts are written to $PY_TYPE_PROFILE (default py-types.profile),
+// which PY2-CPP.py --type-profile reads back to specialize monomorphic
+// functions and sites.
+inline unsigned py_type_code(const PY_OJ& obj) {
+    if (obj.is_big_int()) return 2;
+    switch (obj.type()) {
+        case PY_OJ_Type::INT: return 1;
+        case PY_OJ_Type::FLOAT: return 3;
+        case PY_OJ_Type::CHAR: return 4;
+        case PY_OJ_Type::STRING: return 5;
+        case PY_OJ_Type::LIST: return 6;
+        default: return 7;
+    }
+}
+
+struct PY_TYPE_SITE {
+    static constexpr const char* TYPE_NAMES[] = {"", "int", "bigint", "float", "char", "str", "list", "dict"};
+
+    const char* kind;
+    const char* key;
+    unsigned arity = 0;
+    // Type tuple, three bits per value, -> number of times it was seen
+    std::unordered_map<uint64_t, uint64_t> seen;
+
+    PY_TYPE_SITE(const char* kind, const char* key) : kind(kind), key(key) {}
+    ~PY_TYPE_SITE();
+
+    template<typename... Values>
+    void record(const Values&... values) {
+        static_assert(sizeof...(Values) <= 21, "type tuples are packed into 64 bits");
+        uint64_t tuple = 0;
+        ((tuple = tuple << 3 | py_type_code(values)), ...);
+        arity = sizeof...(Values);
+        ++seen[tuple];
+    }
+
+    void write(std::string& out) const;
+};
+
+// Sites are defined in the generated code, after this object, so they are
+// destroyed first and hand their records over from their destructors.
+struct PY_TYPE_PROFILE {
+    std::string text;
+
+    ~PY_TYPE_PROFILE();
+};
+
+inline PY_TYPE_PROFILE py_type_profile;
+
+inline PY_OJ py_type_binop(PY_TYPE_SITE& site, PY_BINOP_FN op, const PY_OJ& a, const PY_OJ& b) {
+    site.record(a, b);
+    return op(a, b);
+}
+
+#endif // PY2_H
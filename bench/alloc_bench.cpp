@@ -0,0 +1,84 @@
+// List and string workloads for comparing the payload allocators. Build it
+// once per allocator and compare the timings:
+//
+//   clang++ -std=c++17 -O2 bench/alloc_bench.cpp -o alloc_malloc && ./alloc_malloc
+//   clang++ -std=c++17 -O2 -DPY_OJ_ALLOC_POOL bench/alloc_bench.cpp -o alloc_pool && ./alloc_pool
+//   clang++ -std=c++17 -O2 -DPY_OJ_ALLOC_ARENA bench/alloc_bench.cpp -o alloc_arena && ./alloc_arena
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+#if defined(PY_OJ_ALLOC_POOL)
+static const char* const ALLOCATOR = "pool";
+#elif defined(PY_OJ_ALLOC_ARENA)
+static const char* const ALLOCATOR = "arena";
+#else
+static const char* const ALLOCATOR = "malloc";
+#endif
+
+// The workloads are written the way PY2-CPP.py emits them.
+
+// def strings(n):
+//     if n <= 1:
+//         return 0
+//     text = "recursive call " + "temporary"
+//     return strings(n - 1) + strings(n - 2) + len(text + "!")
+static PY_OJ strings(PY_OJ n) {
+    PY_CALL_FRAME();
+    if (PY_COMPARE(n, std::less_equal<>(), PY_OJ(1))) {
+        return PY_OJ(0);
+    }
+    auto text = PY_ADD(PY_OJ("recursive call "), PY_OJ("temporary"));
+    return PY_ADD(PY_ADD(strings(PY_SUB(n, PY_OJ(1))), strings(PY_SUB(n, PY_OJ(2)))),
+                  PY_LEN(PY_ADD(std::move(text), PY_OJ("!"))));
+}
+
+// def lists(n):
+//     if n <= 1:
+//         return 0
+//     items = [n, "a list element", n]
+//     items.append(n)
+//     return lists(n - 1) + lists(n - 2) + len(items)
+static PY_OJ lists(PY_OJ n) {
+    PY_CALL_FRAME();
+    if (PY_COMPARE(n, std::less_equal<>(), PY_OJ(1))) {
+        return PY_OJ(0);
+    }
+    auto items = PY_OJ(std::vector<PY_OJ>{n, PY_OJ("a list element"), n});
+    PY_LIST_APPEND(items, n);
+    return PY_ADD(PY_ADD(lists(PY_SUB(n, PY_OJ(1))), lists(PY_SUB(n, PY_OJ(2)))), PY_LEN(std::move(items)));
+}
+
+// def keep(n):
+//     out = []
+//     for i in range(n):
+//         out.append("long-lived string " + "value")
+//     return len(out)
+static PY_OJ keep(PY_OJ n) {
+    PY_CALL_FRAME();
+    auto out = PY_OJ(std::vector<PY_OJ>{});
+    for (int64_t py_i0 = 0, py_stop0 = PY_RANGE_ARG(n); py_i0 < py_stop0; py_i0 += 1) {
+        PY_LIST_APPEND(out, PY_ADD(PY_OJ("long-lived string "), PY_OJ("value")));
+    }
+    return PY_LEN(std::move(out));
+}
+
+template<typename F>
+static void time_workload(const char* label, F workload) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = workload();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << ALLOCATOR << " " << label << ": " << elapsed.count() << " ms, result ";
+    PY_PRINT(result);
+    PY_FLUSH();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 27;
+    time_workload("strings", [&] { return strings(PY_OJ(n)); });
+    time_workload("lists  ", [&] { return lists(PY_OJ(n)); });
+    time_workload("keep   ", [&] { return keep(PY_OJ(int64_t(1) << (n - 7))); });
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Compares PY_DICT with std::unordered_map<PY_OJ, PY_OJ> hashing the same
+// keys with PY_HASH: counting int keys, looking up short (inline) and long
+// (heap, cached hash) string keys, and looking up keys that are missing.
+//
+//   clang++ -std=c++17 -O2 bench/dict_bench.cpp -o dict_bench && ./dict_bench
+#include <chrono>
+#include <iostream>
+#include <unordered_map>
+
+#include "../PY2.cpp"
+
+using PY_STD_MAP = std::unordered_map<PY_OJ, PY_OJ, PY_OJ_Hash>;
+
+template<typename F>
+static void time_case(const char* label, F run) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = run();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << label << ": " << elapsed.count() << " ms, result ";
+    PY_PRINT(result);
+    PY_FLUSH();
+}
+
+// counts[key] = counts.get(key, 0) + 1 over n keys drawn from distinct values
+static void count_ints(int n, int distinct) {
+    std::vector<PY_OJ> keys;
+    keys.reserve(n);
+    for (int i = 0; i < n; ++i) keys.emplace_back(static_cast<int64_t>((i * 2654435761u) % distinct));
+    PY_OJ one(1), zero(0);
+
+    time_case("count ints     PY_DICT      ", [&] {
+        PY_OJ counts = PY_DICT();
+        for (const PY_OJ& key : keys) PY_SETITEM(counts, key, PY_ADD(PY_DICT_GET(counts, key, zero), one));
+        return PY_LEN(counts);
+    });
+    time_case("count ints     unordered_map", [&] {
+        PY_STD_MAP counts;
+        for (const PY_OJ& key : keys) {
+            auto found = counts.find(key);
+            PY_OJ value = PY_ADD(found == counts.end() ? zero : found->second, one);
+            counts[key] = value;
+        }
+        return PY_OJ(static_cast<int64_t>(counts.size()));
+    });
+}
+
+// Every key is present; rounds passes of lookups over all of them
+static void lookup_strings(const char* label, int n, int rounds, const std::string& prefix) {
+    std::vector<PY_OJ> keys;
+    keys.reserve(n);
+    for (int i = 0; i < n; ++i) keys.emplace_back(prefix + std::to_string(i));
+    PY_OJ dict = PY_DICT();
+    PY_STD_MAP map;
+    for (int i = 0; i < n; ++i) {
+        PY_SETITEM(dict, keys[i], PY_OJ(i));
+        map[keys[i]] = PY_OJ(i);
+    }
+
+    std::string row = std::string(label) + " PY_DICT      ";
+    time_case(row.c_str(), [&] {
+        PY_OJ total(0);
+        for (int r = 0; r < rounds; ++r) {
+            for (const PY_OJ& key : keys) total = PY_ADD(total, PY_GETITEM(dict, key));
+        }
+        return total;
+    });
+    row = std::string(label) + " unordered_map";
+    time_case(row.c_str(), [&] {
+        PY_OJ total(0);
+        for (int r = 0; r < rounds; ++r) {
+            for (const PY_OJ& key : keys) total = PY_ADD(total, map.find(key)->second);
+        }
+        return total;
+    });
+}
+
+// n int keys are present and n other ints are looked up
+static void lookup_misses(int n, int rounds) {
+    PY_OJ dict = PY_DICT();
+    PY_STD_MAP map;
+    std::vector<PY_OJ> missing;
+    missing.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        PY_SETITEM(dict, PY_OJ(static_cast<int64_t>(2 * i)), PY_OJ(i));
+        map[PY_OJ(static_cast<int64_t>(2 * i))] = PY_OJ(i);
+        missing.emplace_back(static_cast<int64_t>(2 * i + 1));
+    }
+
+    time_case("misses         PY_DICT      ", [&] {
+        int64_t found = 0;
+        for (int r = 0; r < rounds; ++r) {
+            for (const PY_OJ& key : missing) found += PY_CONTAINS(dict, key);
+        }
+        return PY_OJ(found);
+    });
+    time_case("misses         unordered_map", [&] {
+        int64_t found = 0;
+        for (int r = 0; r < rounds; ++r) {
+            for (const PY_OJ& key : missing) found += map.count(key);
+        }
+        return PY_OJ(found);
+    });
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+    count_ints(4 * n, n);
+    lookup_strings("short strings ", n, 4, "k");
+    lookup_strings("long strings  ", n, 4, "a-longer-key-");
+    lookup_misses(n, 4);
+    return 0;
+}
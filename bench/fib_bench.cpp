@@ -0,0 +1,33 @@
+// Times the transpiled fibonacci from PY-OUT.cpp against the PY_OJ runtime.
+//
+//   clang++ -std=c++17 -O2 bench/fib_bench.cpp -o fib_bench && ./fib_bench
+//
+// Build with -DPY_RUNTIME='"path/to/old/PY2.cpp"' to time an older runtime
+// side by side with the current one.
+#include <chrono>
+#include <iostream>
+
+#ifndef PY_RUNTIME
+#define PY_RUNTIME "../PY2.cpp"
+#endif
+#include PY_RUNTIME
+
+PY_OJ fibonacci(PY_OJ n) {
+  if (PY_COMPARE(n, std::less_equal<>(), PY_OJ(1))) {
+    return n;
+  }
+  else {
+    return PY_ADD(fibonacci(PY_SUB(n, PY_OJ(1))), fibonacci(PY_SUB(n, PY_OJ(2))));
+  }
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 30;
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = fibonacci(PY_OJ(n));
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << "fibonacci(" << n << "): " << elapsed.count() << " ms" << std::endl;
+    PY_PRINT(result);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+  long long* data;
+  long long size;
+  long long capacity;
+} list;
+
+void append(list* l, long long value) {
+  if (l->size == l->capacity) {
+    l->capacity = l->capacity ? 2 * l->capacity : 8;
+    l->data = realloc(l->data, l->capacity * sizeof(long long));
+  }
+  l->data[l->size++] = value;
+}
+list fill(long long n) {
+  list items = {0, 0, 0};
+  for (long long i = 0; i < n; i++) {
+    append(&items, i * 2);
+  }
+  return items;
+}
+long long total(list* items, long long n) {
+  long long t = 0;
+  for (long long i = 0; i < n; i++) {
+    t = t + items->data[i];
+  }
+  return t;
+}
+int main() {
+  long long n = 1000000;
+  list items = fill(n);
+  printf("%lld\n", total(&items, n));
+  printf("%lld\n", items.size);
+  free(items.data);
+  return 0;
+}
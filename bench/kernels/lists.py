@@ -0,0 +1,19 @@
+def fill(n):
+    items = []
+    for i in range(n):
+        items.append(i * 2)
+    return items
+
+
+def total(items, n):
+    t = 0
+    for i in range(n):
+        t = t + items[i]
+    return t
+
+
+def main():
+    n = 1000000
+    items = fill(n)
+    print(total(items, n))
+    print(len(items))
@@ -0,0 +1,23 @@
+#include <stdio.h>
+
+long long sum_squares(long long n) {
+  long long total = 0;
+  for (long long i = 0; i < n; i++) {
+    total = total + i * i;
+  }
+  return total;
+}
+long long count_pairs(long long n) {
+  long long pairs = 0;
+  for (long long i = 0; i < n; i++) {
+    for (long long j = i; j < n; j++) {
+      pairs = pairs + i - j + 1;
+    }
+  }
+  return pairs;
+}
+int main() {
+  printf("%lld\n", sum_squares(3000000));
+  printf("%lld\n", count_pairs(2000));
+  return 0;
+}
@@ -0,0 +1,22 @@
+def sum_squares(n):
+    total = 0
+    for i in range(n):
+        total = total + i * i
+    return total
+
+
+def count_pairs(n):
+    pairs = 0
+    i = 0
+    while i < n:
+        j = i
+        while j < n:
+            pairs = pairs + i - j + 1
+            j += 1
+        i += 1
+    return pairs
+
+
+def main():
+    print(sum_squares(3000000))
+    print(count_pairs(2000))
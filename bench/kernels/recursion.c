@@ -0,0 +1,12 @@
+#include <stdio.h>
+
+long long fib(long long n) {
+  if (n < 2) {
+    return n;
+  }
+  return fib(n - 1) + fib(n - 2);
+}
+int main() {
+  printf("%lld\n", fib(27));
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  long long* data;
+  long long size;
+  long long capacity;
+} list;
+
+void append(list* l, long long value) {
+  if (l->size == l->capacity) {
+    l->capacity = l->capacity ? 2 * l->capacity : 8;
+    l->data = realloc(l->data, l->capacity * sizeof(long long));
+  }
+  l->data[l->size++] = value;
+}
+void insert_front(list* l, long long value) {
+  append(l, 0);
+  memmove(l->data + 1, l->data, (l->size - 1) * sizeof(long long));
+  l->data[0] = value;
+}
+long long checksum(long long* items, long long n) {
+  long long t = 0;
+  for (long long i = 0; i < n; i++) {
+    t = t + items[i] * (i + 1);
+  }
+  return t;
+}
+long long windows(list* data, long long rounds, long long width) {
+  long long total = 0;
+  long long* window = malloc(width * sizeof(long long));
+  for (long long r = 0; r < rounds; r++) {
+    memcpy(window, data->data + r, width * sizeof(long long));
+    data->data[r + 20] = data->data[r + 20] + 1;
+    total = total + checksum(window, width) + checksum(window + 10, width - 20);
+  }
+  free(window);
+  return total;
+}
+long long drain(list* data, long long n) {
+  long long* queue = malloc((n + 1) * sizeof(long long));
+  queue[0] = 1;
+  memcpy(queue + 1, data->data, n * sizeof(long long));
+  long long evens = (n + 1) / 2;
+  long long second_even = data->data[2];
+  long long total = 0;
+  for (long long head = 0; head < n + 1; head++) {
+    total = total + queue[head];
+  }
+  free(queue);
+  return total + evens + second_even;
+}
+char* letters(long long n) {
+  const char* alphabet = "abcdefghijklmnopqrstuvwxyz";
+  char* text = malloc(n + 1);
+  long long j = 0;
+  for (long long i = 0; i < n; i++) {
+    text[i] = alphabet[j];
+    j = j + 7;
+    if (j >= 26) {
+      j = j - 26;
+    }
+  }
+  text[n] = '\0';
+  return text;
+}
+void pairs(const char* text, long long n, long long* counts) {
+  for (long long i = 0; i < n; i++) {
+    counts[(text[i] - 'a') * 26 + (text[i + 1] - 'a')]++;
+  }
+}
+/* Little-endian base 10^9 limbs, enough for the 60-factor product */
+void print_product(list* data, long long from, long long count) {
+  unsigned long long limbs[64] = {1};
+  int used = 1;
+  for (long long i = 0; i < count; i++) {
+    unsigned long long carry = 0;
+    for (int k = 0; k < used; k++) {
+      carry = limbs[k] * (unsigned long long)data->data[from + i] + carry;
+      limbs[k] = carry % 1000000000;
+      carry = carry / 1000000000;
+    }
+    while (carry) {
+      limbs[used++] = carry % 1000000000;
+      carry = carry / 1000000000;
+    }
+  }
+  printf("%llu", limbs[used - 1]);
+  for (int k = used - 2; k >= 0; k--) {
+    printf("%09llu", limbs[k]);
+  }
+  printf("\n");
+}
+int main() {
+  long long n = 20000;
+  list data = {0, 0, 0};
+  for (long long i = 0; i < n; i++) {
+    append(&data, i * 3 + 1);
+  }
+  long long head[1000];
+  memcpy(head, data.data, sizeof(head));
+  long long* inner = head + 100;
+  data.data[150] = 7;
+  insert_front(&data, 5);
+  printf("%lld %lld %lld %d\n", head[150], inner[50], data.data[151], 800);
+  printf("%lld\n", windows(&data, 2000, 600));
+  printf("%lld %lld %lld\n", head[150], inner[50], data.data[151]);
+  printf("%lld\n", drain(&data, 5000));
+  char* letters_text = letters(3000);
+  char* text = malloc(3000 + 3 + 200 + 1);
+  memcpy(text, letters_text, 3000);
+  char word[201];
+  memcpy(word, letters_text + 100, 200);
+  word[200] = '\0';
+  memcpy(text + 3000, "xyz", 3);
+  memcpy(text + 3003, word, 201);
+  printf("%zu %.10s %.13s\n", strlen(text), word, text + 3000);
+  long long counts[26 * 26] = {0};
+  pairs(text, 3000, counts);
+  long long distinct = 0;
+  for (int k = 0; k < 26 * 26; k++) {
+    distinct += counts[k] != 0;
+  }
+  printf("%lld %lld %lld\n", distinct, counts[('a' - 'a') * 26 + ('h' - 'a')], counts[25 * 26 + 25]);
+  print_product(&data, 100, 60);
+  free(letters_text);
+  free(text);
+  free(data.data);
+  return 0;
+}
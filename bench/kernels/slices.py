@@ -0,0 +1,71 @@
+def checksum(items, n):
+    t = 0
+    for i in range(n):
+        t = t + items[i] * (i + 1)
+    return t
+
+
+def windows(data, rounds, width):
+    total = 0
+    for r in range(rounds):
+        window = data[r:r + width]
+        inner = window[10:width - 10]
+        data[r + 20] = data[r + 20] + 1
+        total = total + checksum(window, width) + checksum(inner, width - 20)
+    return total
+
+
+def drain(data, n):
+    queue = data[0:n]
+    evens = queue[0:n:2]
+    queue.insert(0, 1)
+    total = 0
+    while len(queue) > 0:
+        total = total + queue.pop(0)
+    return total + len(evens) + evens[1]
+
+
+def letters(n):
+    alphabet = "abcdefghijklmnopqrstuvwxyz"
+    text = ""
+    j = 0
+    for i in range(n):
+        text += alphabet[j:j + 1]
+        j = j + 7
+        if j >= 26:
+            j = j - 26
+    return text
+
+
+def pairs(text, n):
+    counts = {}
+    for i in range(n):
+        key = text[i:i + 2]
+        counts[key] = counts.get(key, 0) + 1
+    return counts
+
+
+def main():
+    n = 20000
+    data = []
+    for i in range(n):
+        data.append(i * 3 + 1)
+    head = data[0:1000]
+    inner = head[100:900]
+    data[150] = 7
+    data.insert(0, 5)
+    print(head[150], inner[50], data[151], len(inner))
+    print(windows(data, 2000, 600))
+    print(head[150], inner[50], data[151])
+    print(drain(data, 5000))
+    text = letters(3000)
+    word = text[100:300]
+    text += "xyz"
+    text += word
+    print(len(text), word[0:10], text[3000:3013])
+    counts = pairs(text, 3000)
+    print(len(counts), counts["ah"], counts.get("zz", 0))
+    big = 1
+    for i in range(60):
+        big = big * data[i + 100]
+    print(big)
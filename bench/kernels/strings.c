@@ -0,0 +1,30 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+long long build(long long n) {
+  size_t len = 0;
+  char* s = malloc(2 * n + 1);
+  s[0] = '\0';
+  for (long long i = 0; i < n; i++) {
+    memcpy(s + len, "ab", 3);
+    len += 2;
+  }
+  free(s);
+  return (long long)len;
+}
+long long repeat_join(long long n) {
+  long long total = 0;
+  char word[32];
+  for (long long i = 0; i < n; i++) {
+    strcpy(word, "itemitemitem");
+    strcat(word, "-suffix");
+    total = total + (long long)strlen(word);
+  }
+  return total;
+}
+int main() {
+  printf("%lld\n", build(20000));
+  printf("%lld\n", repeat_join(200000));
+  return 0;
+}
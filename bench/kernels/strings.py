@@ -0,0 +1,18 @@
+def build(n):
+    s = ""
+    for i in range(n):
+        s = s + "ab"
+    return s
+
+
+def repeat_join(n):
+    total = 0
+    for i in range(n):
+        word = "item" * 3 + "-suffix"
+        total = total + len(word)
+    return total
+
+
+def main():
+    print(len(build(20000)))
+    print(repeat_join(200000))
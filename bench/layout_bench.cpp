@@ -0,0 +1,35 @@
+// Compares the default 16-byte PY_OJ layout with the 8-byte tagged one on a
+// scan over a large numeric list.
+//
+//   clang++ -std=c++17 -O2 bench/layout_bench.cpp -o layout16 && ./layout16
+//   clang++ -std=c++17 -O2 -DPY_OJ_TAGGED bench/layout_bench.cpp -o layout8 && ./layout8
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+    int rounds = 20;
+    std::vector<PY_OJ> values;
+    values.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        values.push_back(i % 2 ? PY_OJ(i % 1000) : PY_OJ(static_cast<float>(i % 100)));
+    }
+    PY_OJ list(std::move(values));
+
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ total(0);
+    for (int r = 0; r < rounds; ++r) {
+        for (const PY_OJ& item : list.list_obj()->items) {
+            total = PY_ADD(total, item);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    PY_PRINT(total);
+    PY_FLUSH();
+    std::cout << "sizeof(PY_OJ) = " << sizeof(PY_OJ) << ", " << rounds << " scans of " << n
+              << " items: " << elapsed.count() << " ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Compares unboxed INTS list storage with BOXED storage holding the same
+// values: bytes per element and the time to sum() the list.
+//
+//   clang++ -std=c++17 -O2 bench/list_bench.cpp -o list_bench && ./list_bench
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+static void time_sum(const char* label, const PY_OJ& list, size_t bytes_per_item, int rounds) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ total(0);
+    for (int r = 0; r < rounds; ++r) {
+        total = PY_ADD(total, PY_SUM(list));
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << label << ": " << bytes_per_item << " bytes/item, " << rounds << " sums: "
+              << elapsed.count() << " ms, total ";
+    PY_PRINT(total);
+    PY_FLUSH();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 4000000;
+    int rounds = 20;
+
+    std::vector<int64_t> ints(n);
+    for (int i = 0; i < n; ++i) ints[i] = i % 1000;
+    PY_OJ typed(ints);
+
+    // Appending a string forces BOXED storage; remove it again so both
+    // lists hold the same ints
+    PY_OJ boxed(ints);
+    PY_LIST_APPEND(boxed, PY_OJ("boxed"));
+    PY_LIST_DELETE(boxed, PY_OJ(n));
+
+    time_sum("INTS ", typed, sizeof(int64_t), rounds);
+    time_sum("BOXED", boxed, sizeof(PY_OJ), rounds);
+    return 0;
+}
@@ -0,0 +1,45 @@
+/* Runs a command and reports its wall time and peak RSS for bench/run.py.
+ *
+ *   measure <program> [args...]
+ *
+ * Prints "<elapsed ns> <peak RSS bytes>" as the last line of stderr. The
+ * command is forked from this small process rather than from python3: on
+ * Linux a child's ru_maxrss includes the memory of the process it was
+ * forked from, which would put a floor of the interpreter's RSS under
+ * every measurement. */
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <program> [args...]\n", argv[0]);
+    return 2;
+  }
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pid = fork();
+  if (pid == 0) {
+    execvp(argv[1], argv + 1);
+    perror(argv[1]);
+    _exit(127);
+  }
+  int status;
+  struct rusage usage;
+  if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+    perror("measure");
+    return 2;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long long elapsed = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+#ifdef __APPLE__
+  long long rss = usage.ru_maxrss;
+#else
+  long long rss = usage.ru_maxrss * 1024LL;
+#endif
+  fprintf(stderr, "%lld %lld\n", elapsed, rss);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
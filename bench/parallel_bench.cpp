@@ -0,0 +1,66 @@
+// What the transpiler's --parallel mode emits for [steps(x) for x in xs]: a
+// pure, CPU-bound function (a float recurrence run on boxed PY_OJ values)
+// mapped over a list with PY_PARALLEL_MAP on 1, 2, 4, ... threads, against
+// the serial loop a comprehension lowers to. The speedup column is relative
+// to the serial loop; the results must all match it.
+//
+//   clang++ -std=c++17 -O2 -DPY_OJ_THREADS -pthread bench/parallel_bench.cpp -o parallel_bench && ./parallel_bench
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+static PY_OJ steps(const PY_OJ& x) {
+    PY_OJ half(0.5f), one(1);
+    PY_OJ acc(0.0f), i(0);
+    PY_OJ rounds(200);
+    while (i < rounds) {
+        acc = PY_ADD(PY_MULT(acc, half), PY_DIV(x, PY_ADD(i, one)));
+        i = PY_ADD(i, one);
+    }
+    return acc;
+}
+
+template<typename F>
+static double time_case(const char* label, F run, double serial_ms) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = run();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << label << ": " << elapsed.count() << " ms";
+    if (serial_ms > 0) std::cout << " (" << serial_ms / elapsed.count() << "x)";
+    std::cout << ", result ";
+    PY_PRINT(PY_SUM(result));
+    PY_FLUSH();
+    return elapsed.count();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 30000;
+    PY_OJ xs(std::vector<int64_t>{});
+    for (int i = 1; i <= n; ++i) PY_LIST_APPEND(xs, PY_OJ(i));
+
+    double serial = time_case("serial loop        ", [&] {
+        PY_OJ out(std::vector<PY_OJ>{});
+        PY_OJ x;
+        for (PY_ITER cursor(xs); cursor.next(x); ) PY_LIST_APPEND(out, steps(x));
+        return out;
+    }, 0);
+
+#ifdef PY_OJ_THREADS
+    size_t most = std::max<size_t>(py_thread_count(), 4);
+#else
+    size_t most = 1;
+#endif
+    for (size_t threads = 1; threads <= most; threads *= 2) {
+#ifdef PY_OJ_THREADS
+        py_set_threads(threads);
+#endif
+        std::string label = "PY_PARALLEL_MAP " + std::to_string(threads) + (threads < 10 ? "t " : "t");
+        time_case(label.c_str(), [&] {
+            return PY_PARALLEL_MAP(xs, [&](const PY_OJ& x) -> PY_OJ { return steps(x); });
+        }, serial);
+    }
+    return 0;
+}
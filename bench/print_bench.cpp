@@ -0,0 +1,61 @@
+// Lines per second of PY_PRINT against the previous printing path, which
+// wrote every value with its own std::cout << and ended each line with
+// std::endl. Timings go to stderr, so discard the printed lines:
+//
+//   clang++ -std=c++17 -O2 bench/print_bench.cpp -o print_bench && ./print_bench > /dev/null
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+// The printing path PY_PRINT replaced, kept here as the baseline.
+static void legacy_print_value(const PY_OJ& obj) {
+    switch (obj.type()) {
+        case PY_OJ_Type::INT: std::cout << py_int_text(obj); break;
+        case PY_OJ_Type::FLOAT: std::cout << obj.float_value(); break;
+        case PY_OJ_Type::CHAR: std::cout << obj.char_value(); break;
+        case PY_OJ_Type::STRING: std::cout << obj.str_view(); break;
+        case PY_OJ_Type::LIST: {
+            const PY_LIST_OBJ* list = obj.list_obj();
+            std::cout << "[";
+            for (size_t i = 0; i < list->size(); ++i) {
+                legacy_print_value(list->get(i));
+                if (i < list->size() - 1) std::cout << ", ";
+            }
+            std::cout << "]";
+            break;
+        }
+        case PY_OJ_Type::DICT: break;  // predates dicts
+    }
+}
+
+static void legacy_print(const PY_OJ& a, const PY_OJ& b, const PY_OJ& c) {
+    legacy_print_value(a);
+    std::cout << " ";
+    legacy_print_value(b);
+    std::cout << " ";
+    legacy_print_value(c);
+    std::cout << " " << std::endl;
+}
+
+template<typename Print>
+static void time_lines(const char* label, int n, Print print) {
+    PY_OJ name("line");
+    PY_OJ list(std::vector<int64_t>{1, 2, 3});
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        print(PY_OJ(i), PY_OJ(static_cast<float>(i) * 0.25f), i % 2 ? name : list);
+    }
+    PY_FLUSH();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::cerr << label << ": " << n << " lines in " << elapsed.count() * 1000 << " ms, "
+              << static_cast<long long>(n / elapsed.count()) << " lines/s" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    time_lines("std::cout  ", n, legacy_print);
+    time_lines("PY_PRINT   ", n, [](const PY_OJ& a, const PY_OJ& b, const PY_OJ& c) { PY_PRINT(a, b, c); });
+    return 0;
+}
@@ -0,0 +1,71 @@
+// A list used as a FIFO queue, as in a BFS loop: n items are appended and
+// then popped from the front, with PY_LIST_POP(list, 0) (a start offset)
+// against erasing the first element of the storage vector, as the list
+// did before.
+//
+//   clang++ -std=c++17 -O2 bench/queue_bench.cpp -o queue_bench && ./queue_bench
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+template<bool Offset>
+static PY_OJ drain(int n) {
+    PY_OJ queue(std::vector<int64_t>{});
+    for (int i = 0; i < n; ++i) PY_LIST_APPEND(queue, PY_OJ(i));
+    PY_LIST_OBJ* obj = queue.list_obj();
+    int64_t total = 0;
+    while (obj->size() > 0) {
+        if (Offset) {
+            total += PY_LIST_POP(queue, PY_OJ(0)).int_value();
+        } else {
+            total += obj->ints.front();
+            obj->ints.erase(obj->ints.begin());
+        }
+    }
+    return PY_OJ(total);
+}
+
+// Breadth-first search over the implicit graph i -> 2i+1, 2i+2 on n nodes:
+// every node is appended once and popped from the front once.
+template<bool Offset>
+static PY_OJ bfs(int n) {
+    PY_OJ queue(std::vector<int64_t>{0});
+    PY_LIST_OBJ* obj = queue.list_obj();
+    int64_t visited = 0;
+    while (obj->size() > 0) {
+        int64_t v;
+        if (Offset) {
+            v = PY_LIST_POP(queue, PY_OJ(0)).int_value();
+        } else {
+            v = obj->ints.front();
+            obj->ints.erase(obj->ints.begin());
+        }
+        ++visited;
+        for (int64_t w = 2 * v + 1; w <= 2 * v + 2; ++w) {
+            if (w < n) PY_LIST_APPEND(queue, PY_OJ(w));
+        }
+    }
+    return PY_OJ(visited);
+}
+
+template<typename F>
+static void time_case(const char* label, F run) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = run();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << label << ": " << elapsed.count() << " ms, result ";
+    PY_PRINT(result);
+    PY_FLUSH();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    time_case("drain  erase front ", [&] { return drain<false>(n); });
+    time_case("drain  start offset", [&] { return drain<true>(n); });
+    time_case("bfs    erase front ", [&] { return bfs<false>(n); });
+    time_case("bfs    start offset", [&] { return bfs<true>(n); });
+    return 0;
+}
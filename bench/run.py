@@ -0,0 +1,121 @@
+"""Runs the kernels in bench/kernels on every execution path and compares them.
+
+Each kernel is a Python program (kernel.py, in the subset PY2-CPP.py
+transpiles) plus a hand-typed C version (kernel.c) of the same algorithm.
+The backends are:
+
+  cpython         python3 running kernel.py directly
+  runtime         kernel.py transpiled by PY2-CPP.py, linked with PY2.cpp
+  runtime-tagged  the same, with the 8-byte -DPY_OJ_TAGGED layout
+  typed-c         kernel.c
+
+Every backend runs each kernel --trials times under bench/measure.c. The
+table shows the median and p99 wall time and the peak RSS of the process,
+and every output is checked against CPython's.
+
+  python3 bench/run.py [--trials 10] [--kernels recursion lists] [--backends cpython runtime]
+
+CXX and CC select the compilers (default c++ and cc).
+"""
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.dirname(BENCH_DIR)
+KERNEL_DIR = os.path.join(BENCH_DIR, 'kernels')
+BACKENDS = ['cpython', 'runtime', 'runtime-tagged', 'typed-c']
+
+def kernels():
+    return sorted(name[:-3] for name in os.listdir(KERNEL_DIR) if name.endswith('.py'))
+
+def compile_cmd(cmd):
+    result = subprocess.run(cmd, capture_output=True, text=True)
+    if result.returncode != 0:
+        sys.exit(f"build failed: {' '.join(cmd)}\n{result.stderr}")
+
+def build(kernel, backend, build_dir):
+    """Returns the command that runs kernel on backend, building it first."""
+    source = os.path.join(KERNEL_DIR, kernel)
+    binary = os.path.join(build_dir, f"{kernel}-{backend}")
+    if backend == 'cpython':
+        # The kernels only define main(), like the transpiler's inputs
+        script = os.path.join(build_dir, f"{kernel}.py")
+        with open(source + '.py') as src, open(script, 'w') as out:
+            out.write(src.read() + "\nmain()\n")
+        return [sys.executable, script]
+    if backend == 'typed-c':
+        compile_cmd([os.environ.get('CC', 'cc'), '-O2', source + '.c', '-o', binary])
+        return [binary]
+    cpp = os.path.join(build_dir, f"{kernel}.cpp")
+    if not os.path.exists(cpp):
+        compile_cmd([sys.executable, os.path.join(REPO_DIR, 'PY2-CPP.py'), source + '.py', cpp])
+    flags = ['-DPY_OJ_TAGGED'] if backend == 'runtime-tagged' else []
+    compile_cmd([os.environ.get('CXX', 'c++'), '-std=c++17', '-O2', *flags, '-I', REPO_DIR, cpp,
+                 runtime_object(backend, flags, build_dir), '-o', binary])
+    return [binary]
+
+def runtime_object(backend, flags, build_dir):
+    """PY2.cpp compiled once per backend, with that backend's flags."""
+    obj = os.path.join(build_dir, f"PY2-{backend}.o")
+    if not os.path.exists(obj):
+        compile_cmd([os.environ.get('CXX', 'c++'), '-std=c++17', '-O2', *flags, '-c',
+                     os.path.join(REPO_DIR, 'PY2.cpp'), '-o', obj])
+    return obj
+
+def run_once(measure, cmd):
+    """(milliseconds, stdout, peak RSS in bytes) of one run of cmd."""
+    result = subprocess.run([measure] + cmd, capture_output=True)
+    if result.returncode != 0:
+        sys.exit(f"{' '.join(cmd)} exited with status {result.returncode}\n{result.stderr.decode()}")
+    elapsed_ns, rss = map(int, result.stderr.decode().splitlines()[-1].split())
+    return elapsed_ns / 1e6, result.stdout, rss
+
+def percentile(values, p):
+    # Nearest-rank percentile
+    ordered = sorted(values)
+    rank = max(1, -(-len(ordered) * p // 100))
+    return ordered[int(rank) - 1]
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmark CPython, the PY_OJ runtime and typed C")
+    parser.add_argument('--trials', type=int, default=10, help="timed runs per kernel and backend")
+    parser.add_argument('--kernels', nargs='+', choices=kernels(), default=kernels())
+    parser.add_argument('--backends', nargs='+', choices=BACKENDS, default=BACKENDS)
+    args = parser.parse_args()
+
+    mismatches = 0
+    print(f"{'kernel':<12} {'backend':<15} {'median ms':>10} {'p99 ms':>10} {'peak RSS MB':>12} {'vs cpython':>11}  output")
+    with tempfile.TemporaryDirectory() as build_dir:
+        measure = os.path.join(build_dir, 'measure')
+        compile_cmd([os.environ.get('CC', 'cc'), '-O2', os.path.join(BENCH_DIR, 'measure.c'), '-o', measure])
+        for kernel in args.kernels:
+            expected = None
+            baseline = None
+            backends = ['cpython'] + [b for b in args.backends if b != 'cpython']
+            for backend in backends:
+                cmd = build(kernel, backend, build_dir)
+                run_once(measure, cmd)  # warm-up: page cache, CPU frequency
+                times, rss, outputs = [], 0, set()
+                for _ in range(args.trials):
+                    elapsed, output, peak = run_once(measure, cmd)
+                    times.append(elapsed)
+                    rss = max(rss, peak)
+                    outputs.add(output)
+                median = percentile(times, 50)
+                if backend == 'cpython':
+                    # CPython always runs, as the reference output
+                    expected, baseline = outputs, median
+                    if 'cpython' not in args.backends:
+                        continue
+                status = 'ok' if outputs == expected else 'MISMATCH'
+                mismatches += status != 'ok'
+                print(f"{kernel:<12} {backend:<15} {median:>10.2f} {percentile(times, 99):>10.2f} "
+                      f"{rss / 2**20:>12.1f} {baseline / median:>10.1f}x  {status}")
+    if mismatches:
+        sys.exit(f"{mismatches} backend(s) printed something other than CPython")
+
+if __name__ == '__main__':
+    main()
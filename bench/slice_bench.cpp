@@ -0,0 +1,88 @@
+// Divide-and-conquer code that slices its input at every level, with
+// PY_SLICE (views) against slices copied element by element, as a copying
+// lst[a:b] would: a recursive sum, where the copies are most of the work,
+// and a top-down merge sort, where merging dominates.
+//
+//   clang++ -std=c++17 -O2 bench/slice_bench.cpp -o slice_bench && ./slice_bench
+#include <chrono>
+#include <iostream>
+
+#include "../PY2.cpp"
+
+static PY_OJ copied_slice(const PY_OJ& list, int64_t start, int64_t stop) {
+    PY_LIST_OBJ* copy = new PY_LIST_OBJ(std::vector<PY_OJ>());
+    const PY_LIST_OBJ* source = list.list_obj();
+    if (source->kind == PY_LIST_KIND::VIEW) {
+        copy->copy_elements(*source->view->source, source->view->start + start * source->view->step,
+                            source->view->step, stop - start);
+    } else {
+        copy->copy_elements(*source, start, 1, stop - start);
+    }
+    return PY_OJ(copy);
+}
+
+template<bool Views>
+static PY_OJ half_sum(const PY_OJ& list) {
+    int64_t n = PY_LEN(list).int_value();
+    if (n <= 16) return PY_SUM(list);
+    int64_t half = n / 2;
+    PY_OJ left = Views ? PY_SLICE(list, {}, PY_OJ(half)) : copied_slice(list, 0, half);
+    PY_OJ right = Views ? PY_SLICE(list, PY_OJ(half), {}) : copied_slice(list, half, n);
+    return PY_ADD(half_sum<Views>(left), half_sum<Views>(right));
+}
+
+template<bool Views>
+static PY_OJ merge_sort(const PY_OJ& list) {
+    int64_t n = PY_LEN(list).int_value();
+    if (n <= 1) return list;
+    int64_t half = n / 2;
+    PY_OJ left = Views ? PY_SLICE(list, {}, PY_OJ(half)) : copied_slice(list, 0, half);
+    PY_OJ right = Views ? PY_SLICE(list, PY_OJ(half), {}) : copied_slice(list, half, n);
+    left = merge_sort<Views>(left);
+    right = merge_sort<Views>(right);
+    PY_OJ out(std::vector<int64_t>{});
+    PY_LIST_SPAN a = left.list_obj()->span();
+    PY_LIST_SPAN b = right.list_obj()->span();
+    size_t i = 0, j = 0;
+    while (i < a.size && j < b.size) {
+        PY_OJ x = a.get(i), y = b.get(j);
+        if (x <= y) {
+            PY_LIST_APPEND(out, std::move(x));
+            ++i;
+        } else {
+            PY_LIST_APPEND(out, std::move(y));
+            ++j;
+        }
+    }
+    for (; i < a.size; ++i) PY_LIST_APPEND(out, a.get(i));
+    for (; j < b.size; ++j) PY_LIST_APPEND(out, b.get(j));
+    return out;
+}
+
+template<typename F>
+static void time_case(const char* label, F run) {
+    auto start = std::chrono::steady_clock::now();
+    PY_OJ result = run();
+    auto end = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = end - start;
+    std::cout << label << ": " << elapsed.count() << " ms, result ";
+    PY_PRINT(result);
+    PY_FLUSH();
+}
+
+int main(int argc, char** argv) {
+    int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::vector<int64_t> values(n);
+    uint64_t x = 12345;
+    for (int i = 0; i < n; ++i) {
+        x = x * 6364136223846793005u + 1442695040888963407u;
+        values[i] = static_cast<int64_t>(x >> 40);
+    }
+    PY_OJ list(values);
+
+    time_case("sum   copied slices", [&] { return half_sum<false>(list); });
+    time_case("sum   view slices  ", [&] { return half_sum<true>(list); });
+    time_case("sort  copied slices", [&] { return PY_GETITEM(merge_sort<false>(list), PY_OJ(n / 2)); });
+    time_case("sort  view slices  ", [&] { return PY_GETITEM(merge_sort<true>(list), PY_OJ(n / 2)); });
+    return 0;
+}